@@ -13,6 +13,7 @@
 
 #include <OMR/Model/Mode.hpp>
 #include <OMR/Model/Builder.hpp>
+#include <OMR/Model/Trace.hpp>
 
 #include <VirtualMachineState.hpp>
 #include <TypeDictionary.hpp>
@@ -36,9 +37,23 @@ inline void gen_dbg_msg(JB::IlBuilder* b, const char* file, std::size_t line, co
 
 #define GEN_DBG_MSG(b, msg) gen_dbg_msg(b, __FILE__, __LINE__, __FUNCTION__, msg)
 
-#define GEN_TRACE_MSG(b, msg) GEN_DBG_MSG(b, msg)
+#define GEN_TRACE_MSG(b, msg) OMR::Model::Trace::location(b, __FILE__, __LINE__, __FUNCTION__, msg)
 
-#define GEN_TRACE(b) GEN_DBG_MSG(b, "trace")
+#define GEN_TRACE(b) GEN_TRACE_MSG(b, "trace")
+
+/// Point the trace policy at the interpreter's trace buffer. Call once, at function entry.
+inline void gen_trace_initialize(JB::IlBuilder* b, JB::IlValue* interpreter) {
+#if OMR_MODEL_TRACE == OMR_MODEL_TRACE_RING
+	OMR::Model::Trace::initialize(b, b->StructFieldInstanceAddress("Interpreter", "_trace", interpreter));
+#endif
+}
+
+/// Call the interp_trace helper. Only generated when tracing to stdio.
+inline void gen_interp_trace(JB::IlBuilder* b) {
+	if (OMR::Model::Trace::STDIO) {
+		b->Call("interp_trace", 2, b->Load("interpreter"), b->Load("target"));
+	}
+}
 
 template <OMR::Model::Mode M>
 struct GenDispatchValue;
@@ -88,7 +103,7 @@ struct GenFunctionEntry<OMR::Model::Mode::REAL> {
 #endif
 
 		GEN_TRACE_MSG(b, "MACHINE INITIALIZED");
-		b->Call("interp_trace", 2, interpreter, target);
+		gen_interp_trace(b);
 		// _machine->initialize(b);
 	}
 };
@@ -103,6 +118,8 @@ struct GenFunctionEntry<OMR::Model::Mode::VIRT> {
 
 template <OMR::Model::Mode M>
 struct GenDefault {
+	static constexpr bool TERMINATES = true;
+
 	bool operator()(OMR::Model::Builder<M>* b, Model::Machine<M>& machine) {
 		OMR_TRACE();
 		GEN_TRACE_MSG(b, "DEFAULT HANDLER");
@@ -113,6 +130,8 @@ struct GenDefault {
 
 template <OMR::Model::Mode M>
 struct GenError {
+	static constexpr bool TERMINATES = true;
+
 	bool operator()(OMR::Model::Builder<M>* b, Model::Machine<M>& machine) {
 		OMR_TRACE();
 		GEN_TRACE_MSG(b, "ERROR (UNKNOWN BYTECODE)");
@@ -130,6 +149,7 @@ struct GenError {
 template <OMR::Model::Mode M>
 struct GenHalt {
 	static constexpr std::size_t INSTR_SIZE = 1;
+	static constexpr bool TERMINATES = true;
 
 	bool operator()(OMR::Model::Builder<M>* b, Model::Machine<M>& machine) {
 		GEN_TRACE_MSG(b, "HALT");
@@ -166,22 +186,17 @@ struct GenPushConst {
 		OMR_TRACE();
 		GEN_TRACE_MSG(b, "PUSH_CONST");
 
-		JB::IlValue* address = machine.instruction.address(b).toIl(b);
-		JB::IlValue* index   = machine.instruction.index(b).toIl(b);
-
-		b->Call("print_s", 1, b->Const((void*)"$$$ PUSH_CONST: pc="));
-		b->Call("print_x", 1, address);
-		b->Call("print_s", 1, b->Const((void*)" index="));
-		b->Call("print_u", 1, index);
-		b->Call("print_s", 1, b->Const((void*)"\n"));
-
-		OMR::Model::Int64<M> c = machine.instruction.immediateInt64(b, {b, INSTR_CONST_OFFSET});
+		if (Model::Trace::ENABLED) {
+			Model::Trace::value(b, "$$$ PUSH_CONST: pc=", machine.instruction.address(b).toIl(b));
+			Model::Trace::value(b, "$$$ PUSH_CONST: index=", machine.instruction.index(b).toIl(b));
+		}
 
-		b->Call("print_s", 1, b->Const((void*)"$$$ PUSH_CONST: const-value="));
-		b->Call("print_u", 1, c.toIl(b));
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+		OMR::Model::Value<M, OMR::Model::SlotInt> c = machine.instruction.immediateOperand(b, {b, INSTR_CONST_OFFSET});
+		if (Model::Trace::ENABLED) {
+			Model::Trace::value(b, "$$$ PUSH_CONST: const-value=", c.toIl(b));
+		}
 
-		machine.stack.pushInt64(b, c.toIl(b));
+		machine.stack.push(b, c);
 
 		next(b, machine, OMR::Model::Size<M>(b, INSTR_SIZE));
 		return true;
@@ -195,9 +210,9 @@ struct GenAdd {
 	bool operator()(OMR::Model::Builder<M>* b, Model::Machine<M>& machine) {
 		OMR_TRACE();
 		GEN_TRACE_MSG(b, "ADD");
-		JB::IlValue* rhs = machine.stack.popInt64(b);
-		JB::IlValue* lhs = machine.stack.popInt64(b);
-		machine.stack.pushInt64(b, b->Add(lhs, rhs));
+		OMR::Model::Operand<M> rhs = machine.stack.pop(b);
+		OMR::Model::Operand<M> lhs = machine.stack.pop(b);
+		machine.stack.push(b, OMR::Model::add(b, lhs, rhs));
 		next(b, machine, OMR::Model::Size<M>(b, INSTR_SIZE));
 		return true;
 	}
@@ -212,8 +227,8 @@ struct GenPushLocal {
 		OMR_TRACE();
 		GEN_TRACE_MSG(b, "PUSH_LOCAL");
 		OMR::Model::Size<M> index = machine.instruction.immediateSize(b, {b, INSTR_INDEX_OFFSET});
-		JB::IlValue* value = machine.locals.get(b, index);
-		machine.stack.pushInt64(b, value);
+		OMR::Model::Operand<M> value = machine.locals.get(b, index);
+		machine.stack.push(b, value);
 		next(b, machine, OMR::Model::Size<M>(b, INSTR_SIZE));
 		return true;
 	}
@@ -228,7 +243,7 @@ struct GenPopLocal {
 		OMR_TRACE();
 		GEN_TRACE_MSG(b, "POP_LOCAL");
 		OMR::Model::Size<M> index = machine.instruction.immediateSize(b, {b, INSTR_INDEX_OFFSET});
-		machine.locals.set(b, index, machine.stack.popInt64(b));
+		machine.locals.set(b, index, machine.stack.pop(b));
 		next(b, machine, OMR::Model::Size<M>(b, INSTR_SIZE));
 		return true;
 	}
@@ -243,43 +258,45 @@ struct GenBranchIf {
 		OMR_TRACE();
 		GEN_TRACE_MSG(b, "BRANCH_IF");
 
-		auto addr = machine.instruction.address(b);
-
-		b->Call("print_s", 1, b->Const((void*)"$$$ BRANCH_IF: pc="));
-		b->Call("print_x", 1, addr.toIl(b));
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+		if (Model::Trace::ENABLED) {
+			Model::Trace::value(b, "$$$ BRANCH_IF: pc=", machine.instruction.address(b).toIl(b));
+		}
 
 		OMR::Model::Int64<M> immediate = machine.instruction.immediateInt64(b, {b, INSTR_TARGET_OFFSET});
 		OMR::Model::Int64<M> offset = OMR::Model::add(b, immediate, OMR::Model::Int64<M>(b, INSTR_SIZE));
-		JB::IlValue* cond = machine.stack.popInt64(b);
+		OMR::Model::Operand<M> cond = machine.stack.pop(b);
 
-		ifCmpNotEqualZero(b, machine, cond, offset);
-		b->Call("print_s", 1, b->Const((void*)"$$$ FALSE TAKEN !!!\n"));
-		next(b, machine, {b, INSTR_SIZE});
+		if (ifCmpNotEqualZero(b, machine, cond, offset)) {
+			Model::Trace::message(b, "$$$ FALSE TAKEN !!!\n");
+			next(b, machine, {b, INSTR_SIZE});
+		}
 		return true;
 	}
 };
 
-struct CallBuilderBase {
-protected:
+template <OMR::Model::Mode M>
+struct GenCall {
 	static constexpr std::size_t INSTR_SIZE = 9;
-	static constexpr std::size_t TARGET_OFFSET = 1;
-};
-
-template <Model::Mode>
-struct CallBuilder;
+	static constexpr std::size_t INSTR_TARGET_OFFSET = 1;
 
-template <>
-struct CallBuilder<Model::Mode::VIRT> : CallBuilderBase {
-	static void build(Model::Machine<Model::Mode::VIRT>& machine, JB::IlBuilder* b) {
-		// TODO! machine.pc.next(b, Model::CSize(b, INSTR_SIZE));
+	bool operator()(OMR::Model::Builder<M>* b, Model::Machine<M>& machine) {
+		OMR_TRACE();
+		GEN_TRACE_MSG(b, "CALL");
+		OMR::Model::Ptr<M, Func> callee = machine.instruction.immediateFunc(b, {b, INSTR_TARGET_OFFSET});
+		call(b, machine, callee, {b, INSTR_SIZE});
+		return true;
 	}
 };
 
-template <>
-struct CallBuilder<Model::Mode::REAL> : CallBuilderBase {
-	void build(Model::Machine<Model::Mode::REAL>& machine, JB::IlBuilder* b) {
-		// TODO! something
+template <OMR::Model::Mode M>
+struct GenReturn {
+	static constexpr std::size_t INSTR_SIZE = 1;
+
+	bool operator()(OMR::Model::Builder<M>* b, Model::Machine<M>& machine) {
+		OMR_TRACE();
+		GEN_TRACE_MSG(b, "RETURN");
+		ret(b, machine);
+		return true;
 	}
 };
 
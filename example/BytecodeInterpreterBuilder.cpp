@@ -12,12 +12,17 @@ BytecodeInterpreterCompiler::BytecodeInterpreterCompiler() {
 	set(Op::PUSH_LOCAL, GenPushLocal<M>());
 	set(Op::POP_LOCAL,  GenPopLocal<M>());
 	set(Op::BRANCH_IF,  GenBranchIf<M>());
+	set(Op::CALL,       GenCall<M>());
+	set(Op::RETURN,     GenReturn<M>());
 
 	_handlers.setDefault(GenDefault<M>());
 }
 
-BytecodeInterpreterBuilder::BytecodeInterpreterBuilder(BytecodeInterpreterCompiler* compiler)
-	: JB::BytecodeInterpreterBuilder(compiler->typedict(), compiler->handlers()) {
+BytecodeInterpreterBuilder::BytecodeInterpreterBuilder(BytecodeInterpreterCompiler* compiler, JB::Dispatch dispatch,
+	bool cacheTop, bool countBackEdges)
+	: JB::BytecodeInterpreterBuilder(compiler->typedict(), compiler->handlers(), dispatch)
+	, _cacheTop(cacheTop)
+	, _countBackEdges(countBackEdges) {
 	OMR_TRACE();
 	JB::TypeDictionary* t = typeDictionary();
 	JitHelpers::define(this);
@@ -26,43 +31,48 @@ BytecodeInterpreterBuilder::BytecodeInterpreterBuilder(BytecodeInterpreterCompil
 	DefineReturnType(t->NoType);
 }
 
-JB::IlValue* BytecodeInterpreterBuilder::getOpcode(JB::IlBuilder* b) {
+JB::IlValue* BytecodeInterpreterBuilder::getOpcode(JB::IlBuilder* b, JB::VirtualMachineState* state) {
 	JB::TypeDictionary* t = b->typeDictionary();
+	Model::RealMachine& machine = *static_cast<Model::RealMachine*>(state);
 
-	b->Call("print_s", 1, b->Const((void*)"$$$ DISPATCHING\n"));
+	Model::Trace::message(b, "$$$ DISPATCHING\n");
 
-	JB::IlValue* target = GenDispatchValue<Model::Mode::REAL>()(b, *_machine).unpack();
+	JB::IlValue* target = GenDispatchValue<Model::Mode::REAL>()(b, machine).unpack();
 	JB::IlValue* target32 = b->ConvertTo(t->Int32, target);
 
-	b->Call("interp_trace", 2, b->Load("interpreter"), b->Load("target"));
-	b->Call("print_s", 1, b->Const((char*)"$$$ NEXT: next-bc="));
-	b->Call("print_x", 1, target);
-	b->Call("print_s", 1, b->Const((void*)"\n$$$ NEXT: dispatch: converted-next-bc="));
-	b->Call("print_x", 1, target32);
-	b->Call("print_s", 1, b->Const((void*)"\n"));
+	if (Model::Trace::STDIO) {
+		machine.commit(b); // interp_trace reads the registers, and the cached top, from memory.
+	}
+	gen_interp_trace(b);
+	Model::Trace::value(b, "$$$ NEXT: next-bc=", target);
 
 	return target32;
 }
 
 bool BytecodeInterpreterBuilder::buildIL() {
-	GEN_TRACE_MSG(this, "ENTER METHOD");
-
 	JB::IlValue* interpreter = Load("interpreter");
 	JB::IlValue* target = Load("target");
 
+	gen_trace_initialize(this, interpreter);
+	GEN_TRACE_MSG(this, "ENTER METHOD");
+
 	Model::Machine<M>::Factory factory;
 	factory.setInterpreter(interpreter);
 	factory.setFunction(Model::RPtr<Func>::pack(target));
+	factory.setArena(arena());
 
 	OMR::Model::FunctionData<OMR::Model::Mode::REAL> data(
 		OMR::Model::RPtr<std::uint8_t>::pack(
 			StructFieldInstanceAddress("Func", "body", target)));
 
 	_machine.reset(factory.create(this, data));
+	_machine->frames.markEntry(this, _machine->locals.address());
 	_machine->commit(this);
+	_machine->stack.setCacheSize(_cacheTop ? OMR::Model::RealOperandStack::MAX_CACHED : 0);
+	_machine->instruction.func().setCountBackEdges(_countBackEdges);
 
 	GEN_TRACE_MSG(this, "$$$ MACHINE INITIALIZED");
-	Call("interp_trace", 2, interpreter, target);
+	gen_interp_trace(this);
 
 	bool success = buildInterpreterIL(_machine.get()); // dispatch to superclass
 
@@ -70,3 +80,15 @@ bool BytecodeInterpreterBuilder::buildIL() {
 	Return();
 	return success;
 }
+
+std::size_t BytecodeInterpreterBuilder::cacheStates() const {
+	return _cacheTop ? OMR::Model::RealOperandStack::MAX_CACHED + 1 : 1;
+}
+
+void BytecodeInterpreterBuilder::enterCacheState(JB::VirtualMachineState* state, std::size_t cacheState) {
+	static_cast<Model::RealMachine*>(state)->stack.setCached(cacheState);
+}
+
+std::size_t BytecodeInterpreterBuilder::exitCacheState(JB::VirtualMachineState* state) {
+	return static_cast<Model::RealMachine*>(state)->stack.cached();
+}
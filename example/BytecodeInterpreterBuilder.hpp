@@ -16,7 +16,7 @@ public:
 	static constexpr Model::Mode M = Model::Mode::REAL;
 
 	using HandlerTable = 
-		OMR::JitBuilder::BytecodeInterpreterBuilder::HandlerTable<Model::Machine<M>>;
+		OMR::JitBuilder::BytecodeInterpreterBuilder::HandlerTable<Model::Machine<M>, OPCOUNT>;
 
 	BytecodeInterpreterCompiler();
 
@@ -42,14 +42,34 @@ class BytecodeInterpreterBuilder final : public OMR::JitBuilder::BytecodeInterpr
 public:
 	static constexpr Model::Mode M = Model::Mode::REAL;
 
-	BytecodeInterpreterBuilder(BytecodeInterpreterCompiler* compiler);
+	/// If cacheTop is set, the top of the operand stack is cached in a local between handlers,
+	/// and every handler is generated once per cache state. If countBackEdges is set, taken
+	/// backward branches are counted in Func::backedges, for tier-up.
+	BytecodeInterpreterBuilder(BytecodeInterpreterCompiler* compiler,
+		OMR::JitBuilder::Dispatch dispatch = OMR::JitBuilder::Dispatch::SWITCH, bool cacheTop = false,
+		bool countBackEdges = false);
 
-	virtual OMR::JitBuilder::IlValue* getOpcode(OMR::JitBuilder::IlBuilder* b) override;
+	virtual OMR::JitBuilder::IlValue* getOpcode(OMR::JitBuilder::IlBuilder* b,
+		OMR::JitBuilder::VirtualMachineState* state) override;
 
 	virtual bool buildIL() override final;
 
+	/// @group Cache states: the number of operand stack elements cached.
+	/// @{
+
+	virtual std::size_t cacheStates() const override;
+
+	virtual void enterCacheState(OMR::JitBuilder::VirtualMachineState* state, std::size_t cacheState) override;
+
+	virtual std::size_t exitCacheState(OMR::JitBuilder::VirtualMachineState* state) override;
+
+	/// @}
+	///
+
 private:
 	std::unique_ptr<Model::Machine<Model::Mode::REAL>> _machine;
+	bool _cacheTop;
+	bool _countBackEdges;
 };
 
 #endif // BYTECODEINTERPRETERBUILDER_HPP_
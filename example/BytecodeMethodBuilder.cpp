@@ -1,22 +1,44 @@
 #include "BytecodeMethodBuilder.hpp"
 #include "BytecodeHandlers.hpp"
+#include "ValueAnalysis.hpp"
+
+#include <OMR/Model/OperandStackParameters.hpp>
+
+#include <vector>
+
+namespace {
+
+constexpr Model::Mode M = BytecodeMethodCompiler::M;
+
+template <Op OP, typename HandlerT>
+using Case = JB::BytecodeHandlerCase<std::uint32_t(OP), HandlerT>;
+
+using BytecodeHandlerTable = JB::StaticBytecodeHandlerTable<Model::Machine<M>, GenDefault<M>,
+	Case<Op::UNKNOWN,    GenError<M>>,
+	Case<Op::NOP,        GenNop<M>>,
+	Case<Op::HALT,       GenHalt<M>>,
+	Case<Op::PUSH_CONST, GenPushConst<M>>,
+	Case<Op::ADD,        GenAdd<M>>,
+	Case<Op::PUSH_LOCAL, GenPushLocal<M>>,
+	Case<Op::POP_LOCAL,  GenPopLocal<M>>,
+	Case<Op::BRANCH_IF,  GenBranchIf<M>>,
+	Case<Op::CALL,       GenCall<M>>,
+	Case<Op::RETURN,     GenReturn<M>>
+>;
+
+}  // namespace
 
 BytecodeMethodCompiler::BytecodeMethodCompiler() : _typedict() {
 	JitTypes::define(&_typedict);
-	set(Op::UNKNOWN,    GenError<M>());
-	set(Op::NOP,        GenNop<M>());
-	set(Op::HALT,       GenHalt<M>());
-	set(Op::PUSH_CONST, GenPushConst<M>());
-	set(Op::ADD,        GenAdd<M>());
-	set(Op::PUSH_LOCAL, GenPushLocal<M>());
-	set(Op::POP_LOCAL,  GenPopLocal<M>());
-	set(Op::BRANCH_IF,  GenBranchIf<M>());
-	_handlers.setDefault(GenDefault<M>());
 }
 
-BytecodeMethodBuilder::BytecodeMethodBuilder(BytecodeMethodCompiler* compiler, Func* func)
-		: JB::BytecodeMethodBuilder(compiler->typedict(), compiler->handlers())
-		, _func(func) {
+BytecodeMethodBuilder::BytecodeMethodBuilder(BytecodeMethodCompiler* compiler, Func* func, Signature signature)
+		: JB::BytecodeMethodBuilder(compiler->typedict())
+		, _func(func)
+		, _signature(signature)
+		, _data(OMR::Model::CPtr<std::uint8_t>::pack(func->body), builders())
+		, _analysis()
+		, _machine() {
 
 		DefineName("compiled-method");
 		DefineLine("0");
@@ -27,25 +49,181 @@ BytecodeMethodBuilder::BytecodeMethodBuilder(BytecodeMethodCompiler* compiler, F
 		JB::TypeDictionary* t = this->typeDictionary();
 		JitHelpers::define(this);
 		DefineParameter("interpreter", t->PointerTo(t->LookupStruct("Interpreter")));
-		DefineReturnType(t->NoType);
+		if (signature == Signature::NATIVE) {
+			assert(func->nparams <= OMR::Model::NativeParameters::MAX);
+			for (std::size_t i = 0; i < func->nparams; ++i) {
+				DefineParameter(OMR::Model::NativeParameters::name(i), OMR::Model::slotType(t));
+			}
+			DefineReturnType(OMR::Model::slotType(t));
+		} else {
+			DefineReturnType(t->NoType);
+		}
 	}
 
+BytecodeMethodBuilder::~BytecodeMethodBuilder() = default;
+
+bool BytecodeMethodBuilder::frameless() const {
+	assert(_machine != nullptr);
+	return _machine->frameless();
+}
+
 std::uint32_t BytecodeMethodBuilder::getOpcode(std::size_t index) {
 	return std::uint32_t(_func->body[index]);
 }
 
-bool BytecodeMethodBuilder::buildIL() {
-	OMR_TRACE();
+JB::BytecodeInfo BytecodeMethodBuilder::decode(std::size_t index) {
+	return decode_instruction(_func, index);
+}
 
+JB::BytecodeInfo decode_instruction(const Func* func, std::size_t index) {
+	const std::uint8_t* pc = &func->body[index];
+	switch (Op(*pc)) {
+	case Op::NOP:
+		return {GenNop<M>::INSTR_SIZE, true, false, 0};
+	case Op::PUSH_CONST:
+		return {GenPushConst<M>::INSTR_SIZE, true, false, 0};
+	case Op::ADD:
+		return {GenAdd<M>::INSTR_SIZE, true, false, 0};
+	case Op::PUSH_LOCAL:
+		return {GenPushLocal<M>::INSTR_SIZE, true, false, 0};
+	case Op::POP_LOCAL:
+		return {GenPopLocal<M>::INSTR_SIZE, true, false, 0};
+	case Op::BRANCH_IF: {
+		std::int64_t immediate;
+		std::memcpy(&immediate, pc + GenBranchIf<M>::INSTR_TARGET_OFFSET, sizeof(immediate));
+		std::size_t target = index + immediate + GenBranchIf<M>::INSTR_SIZE;
+		return {GenBranchIf<M>::INSTR_SIZE, true, true, target};
+	}
+	case Op::CALL:
+		return {GenCall<M>::INSTR_SIZE, true, false, 0};
+	case Op::RETURN:
+		return {GenReturn<M>::INSTR_SIZE, false, false, 0};
+	case Op::HALT:
+		return {GenHalt<M>::INSTR_SIZE, false, false, 0};
+	default: // unknown bytecodes halt the machine.
+		return {1, false, false, 0};
+	}
+}
+
+bool BytecodeMethodBuilder::analyzeBlocks() {
+	_analysis.reset(new ValueAnalysis(_func, builders()));
+	_analysis->run(OrphanBuilder());
+
+	// A native body has nowhere to put a frame.
+	bool native = _signature == Signature::NATIVE;
+	if (native && _analysis->escapes()) {
+		return false;
+	}
+
+	// The entry state depends on the analysis: a function whose frame never escapes gets none.
 	Model::VirtMachine::Factory factory;
 	factory.setInterpreter(Load("interpreter"));
 	factory.setFunction(Model::CPtr<Func>::pack(_func));
+	factory.setArena(arena());
+
+	if (_analysis->escapes()) {
+		_machine.reset(factory.create(this, _data));
+	} else {
+		_machine.reset(factory.createFrameless(this, _data, native));
+	}
+	setVMState(_machine.get());
+	return true;
+}
+
+void BytecodeMethodBuilder::enterBlock(JB::CBuilder* b, std::size_t index) {
+	const Model::PureMachine* entry = _analysis->entry(index);
+	if (entry == nullptr) {
+		return;
+	}
+
+	Model::VirtMachine* machine = static_cast<Model::VirtMachine*>(b->vmState());
+
+	for (std::size_t i = 0; i < entry->locals.length(); ++i) {
+		Model::PSlotInt value = entry->locals.get(b, Model::PSize::pack(i));
+		if (value.isKnown()) {
+			machine->locals.assume(i, value.unpack());
+		}
+	}
+
+	// Stack facts are only kept while every path agrees on the depth.
+	if (entry->stack.balanced() && entry->stack.depth() == machine->stack.depth()) {
+		for (std::size_t i = 0; i < entry->stack.depth(); ++i) {
+			Model::PSlotInt value = entry->stack.at(i);
+			if (value.isKnown()) {
+				machine->stack.assume(i, value.unpack());
+			}
+		}
+	}
+}
+
+bool BytecodeMethodBuilder::buildIL() {
+	OMR_TRACE();
+
+	gen_trace_initialize(this, Load("interpreter"));
+
+	// The entry state is built once the blocks are analyzed. See analyzeBlocks().
+	BytecodeHandlerTable handlers;
+	if (!buildBytecodeIL(handlers)) {
+		return false;
+	}
+
+	// Unreachable in a native body, whose every path ends in a RETURN.
+	if (_signature == Signature::NATIVE) {
+		Return(OMR::Model::constant(this, OMR::Model::SlotInt(0)));
+	} else {
+		Return();
+	}
+	return true;
+}
+
+NativeAdapterBuilder::NativeAdapterBuilder(BytecodeMethodCompiler* compiler, Func* func, void* native)
+		: JB::MethodBuilder(compiler->typedict())
+		, _func(func)
+		, _native(native) {
+
+		DefineName("native-adapter");
+		DefineLine("0");
+		DefineFile("<generated>");
+
+		JB::TypeDictionary* t = this->typeDictionary();
+		JitHelpers::define(this);
+		JitHelpers::defineNative(this, func->nparams);
+		DefineParameter("interpreter", t->PointerTo(t->LookupStruct("Interpreter")));
+		DefineReturnType(t->NoType);
+	}
+
+bool NativeAdapterBuilder::buildIL() {
+	JB::TypeDictionary* t = typeDictionary();
+	JB::IlType* ptype = t->PointerTo(OMR::Model::slotType(t));
+	JB::IlValue* interpreter = Load("interpreter");
+	JB::IlValue* sp = LoadIndirect("Interpreter", "_sp", interpreter);
+
+	// The caller left the arguments on top of the stack.
+	std::int64_t nparams = std::int64_t(_func->nparams);
+	std::vector<JB::IlValue*> arguments;
+	arguments.push_back(ConstAddress(_native));
+	arguments.push_back(interpreter);
+	for (std::int64_t i = 0; i < nparams; ++i) {
+		arguments.push_back(LoadAt(ptype, IndexAt(ptype, sp, Const(i - nparams))));
+	}
+	JB::IlValue* result = ComputedCall("call_native", std::int32_t(arguments.size()), arguments.data());
+
+	// Return as the function's RETURN would: pop the frame, and leave the result in place of
+	// the frame record. Entered from the host, there is no record: leave the result on top.
+	Model::FrameChain frames;
+	frames.initialize(this, interpreter);
+	JB::IlValue* frame = frames.record(this);
+	JB::IlBuilder* caller = nullptr;
+	JB::IlBuilder* host = nullptr;
+	IfThenElse(&caller, &host, NotEqualTo(frame, ConstAddress(nullptr)));
 
-	OMR::Model::FunctionData<Model::Mode::VIRT> data(OMR::Model::CPtr<std::uint8_t>::pack(_func->body), builders());
-	std::shared_ptr<Model::VirtMachine> machine(factory.create(this, data));
-	setVMState(machine.get());
+	host->StoreAt(sp, result);
+	host->StoreIndirect("Interpreter", "_sp", interpreter, host->IndexAt(ptype, sp, host->Const(std::int64_t(1))));
 
-	buildBytecodeIL(/* machine.get(), _func */);
+	frames.pop(caller, frame);
+	JB::IlValue* record = caller->ConvertTo(ptype, frame);
+	caller->StoreAt(record, result);
+	caller->StoreIndirect("Interpreter", "_sp", interpreter, caller->IndexAt(ptype, record, caller->Const(std::int64_t(1))));
 
 	Return();
 	return true;
@@ -2,49 +2,86 @@
 #define BYTECODEMETHODBUILDER_HPP_
 
 #include <OMR/BytecodeMethodBuilder.hpp>
+#include <OMR/Model/FunctionData.hpp>
 #include <OMR/Model/Mode.hpp>
 
 #include <Instructions.hpp>
 
-class Func;
+#include <memory>
+
+struct Func;
+class ValueAnalysis;
 
 namespace Model {
 template <OMR::Model::Mode> class Machine;
 }  // namespace Model
 
+/// The bytecode handlers are a static table, defined with the handlers in BytecodeMethodBuilder.cpp.
 class BytecodeMethodCompiler {
 public:
 	static constexpr OMR::Model::Mode M = OMR::Model::Mode::VIRT;
 
-	using BytecodeHandlerTable =
-		OMR::JitBuilder::BytecodeHandlerTable<Model::Machine<M>>;
-
 	BytecodeMethodCompiler();
 
 	OMR::JitBuilder::TypeDictionary* typedict() { return &_typedict; }
 
-	OMR::JitBuilder::BytecodeHandlerTable<Model::Machine<M>>* handlers() { return &_handlers; }
-
 private:
-	template <typename HandlerT>
-	void set(Op op, const HandlerT& handler) {
-		_handlers.set(std::uint32_t(op), handler);
-	}
-
 	OMR::JitBuilder::TypeDictionary _typedict;
-	OMR::JitBuilder::BytecodeHandlerTable<Model::Machine<M>> _handlers;
+};
+
+/// How a compiled body takes its arguments and gives back its result.
+enum class Signature {
+	STACK,  //< void(Interpreter*): arguments and result on the operand stack. Called by CALL.
+	NATIVE, //< SlotInt(Interpreter*, SlotInt...): in registers. See NativeFn.
 };
 
 class BytecodeMethodBuilder : public OMR::JitBuilder::BytecodeMethodBuilder {
 public:
-	BytecodeMethodBuilder(BytecodeMethodCompiler* compiler, Func* func);
+	/// A NATIVE body can only be built for a function whose frame never escapes, with at
+	/// most NativeParameters::MAX parameters. For any other, buildIL() fails.
+	BytecodeMethodBuilder(BytecodeMethodCompiler* compiler, Func* func, Signature signature = Signature::STACK);
 
 	virtual std::uint32_t getOpcode(std::size_t index) override final;
 
+	virtual OMR::JitBuilder::BytecodeInfo decode(std::size_t index) override final;
+
+	virtual bool buildIL() override final;
+
+	/// True if the body was built with no frame on the operand stack. Valid once built.
+	bool frameless() const;
+
+	~BytecodeMethodBuilder();
+
+protected:
+	/// Find the values known on entry to each block, and whether the frame escapes, then
+	/// build the entry state. See ValueAnalysis. Fails a NATIVE build if the frame escapes.
+	virtual bool analyzeBlocks() override final;
+
+	/// Assume the values known on entry to the block, in its working state.
+	virtual void enterBlock(OMR::JitBuilder::CBuilder* b, std::size_t index) override final;
+
+private:
+	Func* _func;
+	Signature _signature;
+	OMR::Model::FunctionData<OMR::Model::Mode::VIRT> _data;
+	std::unique_ptr<ValueAnalysis> _analysis;
+	std::unique_ptr<Model::Machine<OMR::Model::Mode::VIRT>> _machine;
+};
+
+/// The STACK body of a function with a NATIVE one: a thin adapter that loads the arguments
+/// from the operand stack, calls the native body, and returns as the function's RETURN would.
+class NativeAdapterBuilder : public OMR::JitBuilder::MethodBuilder {
+public:
+	NativeAdapterBuilder(BytecodeMethodCompiler* compiler, Func* func, void* native);
+
 	virtual bool buildIL() override final;
 
 private:
 	Func* _func;
+	void* _native;
 };
 
+/// Length and successors of the bytecode at index in func.
+OMR::JitBuilder::BytecodeInfo decode_instruction(const Func* func, std::size_t index);
+
 #endif // BYTECODEMETHODBUILDER_HPP_
@@ -0,0 +1,116 @@
+#include <CompileQueue.hpp>
+#include <Interpreter.hpp>
+
+#include <cassert>
+
+CompileQueue::CompileQueue(std::size_t workers)
+	: _compilers()
+	, _mutex()
+	, _wake()
+	, _idle()
+	, _requests()
+	, _busy(0)
+	, _stop(false)
+	, _stats()
+	, _workers() {
+	assert(workers > 0);
+	// The compilers are made here, not on the workers, so their TypeDictionaries are
+	// built one at a time.
+	for (std::size_t i = 0; i < workers; ++i) {
+		_compilers.emplace_back(new BytecodeMethodCompiler());
+	}
+	for (std::size_t i = 0; i < workers; ++i) {
+		_workers.emplace_back(&CompileQueue::work, this, _compilers[i].get());
+	}
+}
+
+CompileQueue::~CompileQueue() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_wake.notify_all();
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+	for (const Request& request : _requests) {
+		request.func->queued.store(false, std::memory_order_relaxed);
+	}
+}
+
+CompileQueue::Stats CompileQueue::compileAll(const std::vector<Func*>& funcs, std::size_t workers) {
+	CompileQueue queue(workers);
+	for (Func* func : funcs) {
+		queue.enqueue(func);
+	}
+	queue.drain();
+	return queue.stats();
+}
+
+bool CompileQueue::enqueue(Func* func) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_stop || func->installedBody() != nullptr || func->queued.exchange(true)) {
+			_stats.deduplicated += 1;
+			return false;
+		}
+		_requests.push_back({func, Clock::now()});
+		_stats.enqueued += 1;
+		_stats.depth = _requests.size();
+		if (_stats.depth > _stats.maxDepth) {
+			_stats.maxDepth = _stats.depth;
+		}
+	}
+	_wake.notify_one();
+	return true;
+}
+
+void CompileQueue::drain() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this] { return _stop || (_requests.empty() && _busy == 0); });
+}
+
+std::size_t CompileQueue::depth() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _requests.size();
+}
+
+CompileQueue::Stats CompileQueue::stats() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _stats;
+}
+
+void CompileQueue::work(BytecodeMethodCompiler* compiler) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_wake.wait(lock, [this] { return _stop || !_requests.empty(); });
+		if (_stop) {
+			break;
+		}
+
+		Request request = _requests.front();
+		_requests.pop_front();
+		_stats.depth = _requests.size();
+		_busy += 1;
+
+		lock.unlock();
+		CompiledBodies bodies = Runtime::get().compile_body(compiler, request.func);
+		request.func->install(bodies);
+		Clock::time_point now = Clock::now();
+		lock.lock();
+
+		recordInstall(request, now);
+		_busy -= 1;
+		_idle.notify_all();
+	}
+	_idle.notify_all();
+}
+
+void CompileQueue::recordInstall(const Request& request, Clock::time_point now) {
+	std::chrono::nanoseconds latency = now - request.enqueued;
+	_stats.installed += 1;
+	_stats.totalLatency += latency;
+	if (latency > _stats.maxLatency) {
+		_stats.maxLatency = latency;
+	}
+}
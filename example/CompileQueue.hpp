@@ -0,0 +1,95 @@
+#if !defined(COMPILEQUEUE_HPP_)
+#define COMPILEQUEUE_HPP_
+
+#include <BytecodeMethodBuilder.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Func;
+
+/// Compiles functions on background worker threads.
+///
+/// Each worker has its own BytecodeMethodCompiler, so workers never share a TypeDictionary
+/// with each other, or with the interpreters. A compiled body is published by atomically storing Func::cbody, and is
+/// picked up by the next Interpreter::run of the function.
+///
+/// Requests are deduplicated on Func::queued, which is set when a request is accepted, so
+/// a function is compiled at most once, whichever queue asks for it.
+///
+/// initializeJit() must have returned before a queue is created, and shutdownJit() must
+/// not be called until it is destroyed. JitBuilder compiles touch process-global compiler
+/// state, and are not thread safe, so every JitBuilder compile in the process runs under the
+/// runtime's compile lock; see Runtime::compile_body(). Workers overlap only the work around
+/// it: the bytecode analysis before a compile, and the install after. Extra workers help
+/// little while the compile itself dominates, which example-bench measures.
+///
+/// A Func must outlive its request: keep it alive until drain() returns, or the queue is destroyed.
+class CompileQueue {
+public:
+	struct Stats {
+		std::size_t enqueued = 0;     //< requests accepted.
+		std::size_t deduplicated = 0; //< requests dropped, because the Func was already queued or compiled.
+		std::size_t installed = 0;    //< compiled bodies published.
+		std::size_t depth = 0;        //< requests waiting, not counting the ones being compiled.
+		std::size_t maxDepth = 0;
+		std::chrono::nanoseconds totalLatency{0}; //< sum of enqueue-to-install times.
+		std::chrono::nanoseconds maxLatency{0};
+	};
+
+	explicit CompileQueue(std::size_t workers = 1);
+
+	CompileQueue(const CompileQueue&) = delete;
+
+	CompileQueue& operator=(const CompileQueue&) = delete;
+
+	/// Compile every function in funcs on the given number of workers, and return once all
+	/// are installed. Functions that already have a body, or are already queued, are skipped.
+	static Stats compileAll(const std::vector<Func*>& funcs, std::size_t workers = 1);
+
+	/// Stops the workers once their current compiles finish. Requests still waiting are
+	/// dropped, and their functions can be queued again.
+	~CompileQueue();
+
+	/// Request a background compile of func. Returns false if func is already queued or compiled.
+	bool enqueue(Func* func);
+
+	/// Block until every accepted request has been installed.
+	void drain();
+
+	/// The number of requests waiting.
+	std::size_t depth() const;
+
+	Stats stats() const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Request {
+		Func* func;
+		Clock::time_point enqueued;
+	};
+
+	void work(BytecodeMethodCompiler* compiler);
+
+	void recordInstall(const Request& request, Clock::time_point now);
+
+	std::vector<std::unique_ptr<BytecodeMethodCompiler>> _compilers; //< one per worker.
+	mutable std::mutex _mutex;
+	std::condition_variable _wake; //< signalled when a request arrives, or on shutdown.
+	std::condition_variable _idle; //< signalled when a request is installed.
+	std::deque<Request> _requests;
+	std::size_t _busy;               //< requests taken by a worker, and not yet installed.
+	bool _stop;
+	Stats _stats;
+	std::vector<std::thread> _workers;
+};
+
+#endif // COMPILEQUEUE_HPP_
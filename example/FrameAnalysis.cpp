@@ -0,0 +1,139 @@
+#include <FrameAnalysis.hpp>
+#include <BytecodeHandlers.hpp>
+#include <BytecodeMethodBuilder.hpp>
+#include <Inliner.hpp>
+#include <Interpreter.hpp>
+
+#include <OMR/Model/SlotType.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t SLOT_SIZE = OMR::Model::SLOT_SIZE;
+
+constexpr std::size_t UNVISITED = std::size_t(-1);
+
+/// The function called by the CALL at pc.
+const Func* callee(const std::uint8_t* pc) {
+	const Func* func;
+	std::memcpy(&func, pc + GenCall<Model::Mode::REAL>::INSTR_TARGET_OFFSET, sizeof(func));
+	return func;
+}
+
+/// The net number of operands the bytecode at pc pushes.
+std::int64_t stack_effect(const std::uint8_t* pc) {
+	switch (Op(*pc)) {
+	case Op::CALL:
+		return 1 - std::int64_t(callee(pc)->nparams);
+	case Op::RETURN:
+		return -1;
+	case Op::PUSH_CONST:
+	case Op::PUSH_LOCAL:
+		return 1;
+	case Op::ADD:
+	case Op::POP_LOCAL:
+	case Op::BRANCH_IF:
+		return -1;
+	default:
+		return 0;
+	}
+}
+
+/// Slots the bytecode at pc uses above its operands while it runs. A CALL's frame record
+/// belongs to the caller's frame; the callee's locals and operands belong to the callee's.
+std::size_t stack_overhead(const std::uint8_t* pc) {
+	return Op(*pc) == Op::CALL ? sizeof(Frame) / SLOT_SIZE : 0;
+}
+
+}  // namespace
+
+std::size_t max_operand_depth(const Func* func) {
+	std::vector<std::size_t> depths; //< bytecode index -> depth on entry, or UNVISITED.
+	std::vector<std::size_t> worklist;
+	std::size_t max = 0;
+
+	auto visit = [&](std::size_t index, std::size_t depth) -> bool {
+		if (index >= depths.size()) {
+			depths.resize(index + 1, UNVISITED);
+		}
+		if (depths[index] == UNVISITED) {
+			depths[index] = depth;
+			worklist.push_back(index);
+			return true;
+		}
+		return depths[index] == depth;
+	};
+
+	visit(0, 0);
+	while (!worklist.empty()) {
+		std::size_t index = worklist.back();
+		worklist.pop_back();
+
+		const std::uint8_t* pc = &func->body[index];
+		std::int64_t depth = std::int64_t(depths[index]) + stack_effect(pc);
+		if (depth < 0) {
+			return UNBOUNDED_DEPTH; // underflows: leave it to the guard page.
+		}
+		std::size_t peak = std::max(std::size_t(depth), depths[index] + stack_overhead(pc));
+		if (peak > max) {
+			max = peak;
+		}
+
+		// Operands popped by a branch are popped before it is taken.
+		OMR::JitBuilder::BytecodeInfo info = decode_instruction(func, index);
+		if (info.fallsThrough && !visit(index + info.length, std::size_t(depth))) {
+			return UNBOUNDED_DEPTH;
+		}
+		if (info.branches && !visit(info.target, std::size_t(depth))) {
+			return UNBOUNDED_DEPTH;
+		}
+	}
+
+	return max;
+}
+
+std::size_t frame_bytes(Func* func) {
+	std::size_t bytes = func->frameBytes.load(std::memory_order_relaxed);
+	if (bytes == 0) {
+		std::size_t depth = max_operand_depth(func);
+		// Never 0, since 0 means not yet computed.
+		bytes = depth == UNBOUNDED_DEPTH ? UNBOUNDED_DEPTH : (func->nlocals + depth + 1) * SLOT_SIZE;
+		func->frameBytes.store(bytes, std::memory_order_relaxed);
+	}
+	return bytes;
+}
+
+bool frame_escapes(const Func* func) {
+	std::vector<bool> visited;
+	std::vector<std::size_t> worklist = {0};
+
+	while (!worklist.empty()) {
+		std::size_t index = worklist.back();
+		worklist.pop_back();
+		if (index >= visited.size()) {
+			visited.resize(index + 1, false);
+		}
+		if (visited[index]) {
+			continue;
+		}
+		visited[index] = true;
+
+		const std::uint8_t* pc = &func->body[index];
+		if (Op(*pc) == Op::HALT || (Op(*pc) == Op::CALL && !Inliner::inlinable(callee(pc)))) {
+			return true;
+		}
+
+		OMR::JitBuilder::BytecodeInfo info = decode_instruction(func, index);
+		if (info.fallsThrough) {
+			worklist.push_back(index + info.length);
+		}
+		if (info.branches) {
+			worklist.push_back(info.target);
+		}
+	}
+
+	return false;
+}
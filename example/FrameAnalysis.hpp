@@ -0,0 +1,26 @@
+#if !defined(FRAMEANALYSIS_HPP_)
+#define FRAMEANALYSIS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+struct Func;
+
+/// Returned by max_operand_depth when the depth is not bounded, or not the same
+/// on every path into some bytecode.
+constexpr std::size_t UNBOUNDED_DEPTH = std::size_t(-1);
+
+/// The most operands func can have on the stack at once, over every reachable bytecode.
+std::size_t max_operand_depth(const Func* func);
+
+/// The stack bytes one activation of func can use: its locals, plus its deepest operand
+/// stack. Computed once, and cached in the Func. UNBOUNDED_DEPTH if there is no bound.
+std::size_t frame_bytes(Func* func);
+
+/// True if func's frame can escape on some path through its reachable bytecodes: it halts,
+/// or makes a call that is not inlined. Decided from the bytecodes alone, before any
+/// compile, so it never misses an escape that ValueAnalysis finds, but may see one on a
+/// path that known values rule out.
+bool frame_escapes(const Func* func);
+
+#endif // FRAMEANALYSIS_HPP_
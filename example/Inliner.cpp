@@ -0,0 +1,103 @@
+#include <Inliner.hpp>
+#include <BytecodeHandlers.hpp>
+#include <BytecodeMethodBuilder.hpp>
+#include <Interpreter.hpp>
+
+#include <OMR/Model/FunctionData.hpp>
+#include <OMR/Model/Trace.hpp>
+
+#include <BytecodeBuilderTable.hpp>
+#include <BytecodeHandlerTable.hpp>
+
+#include <cstring>
+
+namespace {
+
+constexpr Model::Mode M = Model::Mode::VIRT;
+
+template <Op OP, typename HandlerT>
+using Case = JB::BytecodeHandlerCase<std::uint32_t(OP), HandlerT>;
+
+/// The handlers of the bytecodes that can be inlined. See Inliner::inlinable().
+using InlineHandlerTable = JB::StaticBytecodeHandlerTable<Model::VirtMachine, GenDefault<M>,
+	Case<Op::NOP,        GenNop<M>>,
+	Case<Op::PUSH_CONST, GenPushConst<M>>,
+	Case<Op::ADD,        GenAdd<M>>,
+	Case<Op::PUSH_LOCAL, GenPushLocal<M>>,
+	Case<Op::POP_LOCAL,  GenPopLocal<M>>,
+	Case<Op::CALL,       GenCall<M>>,
+	Case<Op::RETURN,     GenReturn<M>>
+>;
+
+template <typename T>
+T immediate(const std::uint8_t* pc, std::size_t offset) {
+	T value;
+	std::memcpy(&value, pc + offset, sizeof(value));
+	return value;
+}
+
+}  // namespace
+
+bool Inliner::inlinable(const Func* callee, std::size_t depth) {
+	if (depth >= MAX_DEPTH) {
+		return false;
+	}
+
+	std::size_t index = 0;
+	while (index < MAX_BYTES) {
+		const std::uint8_t* pc = &callee->body[index];
+		switch (Op(*pc)) {
+		case Op::NOP:
+		case Op::PUSH_CONST:
+		case Op::ADD:
+		case Op::PUSH_LOCAL:
+		case Op::POP_LOCAL:
+			break;
+		case Op::CALL:
+			if (!inlinable(immediate<const Func*>(pc, GenCall<M>::INSTR_TARGET_OFFSET), depth + 1)) {
+				return false;
+			}
+			break;
+		case Op::RETURN:
+			return true;
+		default: // branches and halts are never inlined.
+			return false;
+		}
+		index += decode_instruction(callee, index).length;
+	}
+	return false;
+}
+
+void Inliner::inline_call(OMR::Model::CBuilder* b, Model::VirtMachine& caller, const Func* callee) {
+	assert(inlinable(callee, caller.inlineDepth()));
+	Model::Trace::staticValue(b, "$$$ Inliner: inline callee=", std::uintptr_t(callee));
+
+	// The callee is straight-line code: one block, whose cursor walks its bytecodes.
+	JB::BytecodeBuilderTable builders;
+	builders.addLeader(0);
+	builders.numberBlocks();
+	OMR::Model::FunctionData<M> data(OMR::Model::CPtr<std::uint8_t>::pack(const_cast<std::uint8_t*>(callee->body)), &builders);
+
+	Model::VirtMachine machine(b, data, caller, const_cast<Func*>(callee));
+	std::size_t base = machine.stack.depth(); // the caller's stack, without the arguments.
+
+	InlineHandlerTable handlers;
+	std::size_t index = 0;
+	while (true) {
+		builders.setCursor(index);
+		Op op = Op(callee->body[index]);
+		handlers.invoke(b, machine, std::uint32_t(op));
+		if (op == Op::RETURN) {
+			break;
+		}
+		index += decode_instruction(callee, index).length;
+	}
+
+	// Like RETURN: anything the callee left under its result is dropped.
+	OMR::Model::KSlotInt result = machine.stack.pop(b);
+	while (machine.stack.depth() > base) {
+		machine.stack.pop(b);
+	}
+	machine.stack.push(b, result);
+	caller.stack = machine.stack;
+}
@@ -0,0 +1,36 @@
+#if !defined(INLINER_HPP_)
+#define INLINER_HPP_
+
+#include <OMR/Model/Builder.hpp>
+#include <OMR/Model/Mode.hpp>
+
+#include <cstddef>
+
+struct Func;
+
+namespace Model {
+template <OMR::Model::Mode> class Machine;
+}  // namespace Model
+
+/// Compile-time inlining of small callees into compiled code.
+///
+/// A callee is inlined if its body is straight-line code ending in RETURN, small enough,
+/// and every function it calls can be inlined in turn, within the depth budget. Inlined
+/// code is built by the same bytecode handlers as any compiled code, on a machine of its
+/// own that runs entirely on buffered state: the arguments are taken straight from the
+/// caller's stack values, and the callee's locals live in an array with no memory behind
+/// it. No frame record is built, and nothing is written to the operand stack.
+class Inliner {
+public:
+	static constexpr std::size_t MAX_BYTES = 64; //< largest callee body inlined, in bytes.
+	static constexpr std::size_t MAX_DEPTH = 3;  //< most calls inlined into one another.
+
+	/// True if callee can be inlined, depth levels of inlining down.
+	static bool inlinable(const Func* callee, std::size_t depth = 0);
+
+	/// Generate callee's body into b. The arguments are popped off caller's stack, and the
+	/// result is pushed in their place. callee must be inlinable at caller's inline depth.
+	static void inline_call(OMR::Model::CBuilder* b, Model::Machine<OMR::Model::Mode::VIRT>& caller, const Func* callee);
+};
+
+#endif // INLINER_HPP_
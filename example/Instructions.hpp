@@ -14,6 +14,7 @@ enum class Op : std::uint8_t {
 	POP_LOCAL,
 	BRANCH_IF,
 	CALL,
+	RETURN,
 	COUNT_
 };
 
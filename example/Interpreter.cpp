@@ -1,27 +1,292 @@
 #include <Interpreter.hpp>
 #include <BytecodeMethodBuilder.hpp>
 #include <BytecodeInterpreterBuilder.hpp>
+#include <CompileQueue.hpp>
+#include <FrameAnalysis.hpp>
 
-InterpretFn Interpreter::_interpret = nullptr;
+#include <OMR/Model/OperandStackParameters.hpp>
 
-InterpretFn Interpreter::compile_interpret_fn() {
-	BytecodeInterpreterCompiler compiler;
-	BytecodeInterpreterBuilder builder(&compiler);
+#include <algorithm>
+#include <csetjmp>
+#include <csignal>
+#include <cstring>
+#include <mutex>
+
+Runtime& Runtime::get() {
+	static Runtime* runtime = new Runtime();
+	return *runtime;
+}
+
+Runtime::Runtime()
+	: _jitLock()
+	, _compiler()
+	, _interpreterCompiler(new BytecodeInterpreterCompiler())
+	, _interpretOnce()
+	, _interpretFns()
+	, _segments()
+	, _stacks(InterpreterOptions().stackSize, MAX_POOLED_STACKS)
+	, _statsLock()
+	, _arenaStats() {}
+
+OMR::GuardedStack Runtime::acquire_stack(const InterpreterOptions& options) {
+	if (options.segmentedStack) {
+		return _segments.acquire();
+	}
+	if (OMR::GuardedStack::roundToPages(options.stackSize) == _stacks.segmentSize() && !options.hugePages) {
+		return _stacks.acquire();
+	}
+	return OMR::GuardedStack(options.stackSize, options.hugePages);
+}
+
+void Runtime::release_stack(const InterpreterOptions& options, OMR::GuardedStack stack) {
+	if (options.segmentedStack) {
+		_segments.release(std::move(stack));
+	} else if (!options.hugePages) {
+		_stacks.release(std::move(stack)); // unmapped, unless it is the pool's size.
+	}
+}
+
+OMR::Arena::Stats Runtime::arenaStats() const {
+	std::lock_guard<std::mutex> lock(_statsLock);
+	return _arenaStats;
+}
+
+void Runtime::record_arena(const OMR::Arena::Stats& stats) {
+	std::lock_guard<std::mutex> lock(_statsLock);
+	_arenaStats += stats;
+}
+
+InterpretFn Runtime::interpret_fn(Dispatch dispatch, bool cacheTop, bool countBackEdges) {
+	assert(std::size_t(dispatch) < DISPATCH_COUNT);
+	std::size_t i = (std::size_t(dispatch) * 2 + (cacheTop ? 1 : 0)) * 2 + (countBackEdges ? 1 : 0);
+	std::call_once(_interpretOnce[i], [this, dispatch, cacheTop, countBackEdges, i] {
+		_interpretFns[i] = compile_interpret_fn(dispatch, cacheTop, countBackEdges);
+	});
+	return _interpretFns[i];
+}
+
+InterpretFn Runtime::compile_interpret_fn(Dispatch dispatch, bool cacheTop, bool countBackEdges) {
+	std::lock_guard<std::mutex> lock(_jitLock);
+	BytecodeInterpreterBuilder builder(_interpreterCompiler.get(), dispatch, cacheTop, countBackEdges);
 	void* interpret = nullptr;
 	std::int32_t rc = compileMethodBuilder(&builder, &interpret);
 	if (rc != 0) {
 		fprintf(stderr, "Failed to compile interpret fn\n");
 		assert(0);
 	}
+	record_arena(builder.arena()->stats());
 	return (InterpretFn)interpret;
 }
 
-void Interpreter::compile(Func* func) {
-	assert(func->cbody == nullptr);
-	BytecodeMethodBuilder builder(&_compiler, func);
-	std::int32_t rc = compileMethodBuilder(&builder, (void**)&func->cbody);
+CompiledBodies Runtime::compile_body(BytecodeMethodCompiler* compiler, Func* func) {
+	// frame_escapes() sees every escape the native build's analysis would, so that build
+	// is only attempted when it can succeed. It only reads the bytecodes, so it runs before
+	// the compile lock is taken, and overlaps with other threads' compiles.
+	bool tryNative = func->nparams <= OMR::Model::NativeParameters::MAX && !frame_escapes(func);
+
+	std::lock_guard<std::mutex> lock(_jitLock);
+	CompiledBodies bodies;
+
+	if (tryNative) {
+		BytecodeMethodBuilder builder(compiler, func, Signature::NATIVE);
+		void* native = nullptr;
+		if (compileMethodBuilder(&builder, &native) == 0) {
+			record_arena(builder.arena()->stats());
+			bodies.native = native;
+		}
+	}
+
+	void* body = nullptr;
+	std::int32_t rc;
+	if (bodies.native != nullptr) {
+		// A native body never has a frame, and neither has its adapter.
+		NativeAdapterBuilder builder(compiler, func, bodies.native);
+		rc = compileMethodBuilder(&builder, &body);
+		bodies.frameless = true;
+	} else {
+		BytecodeMethodBuilder builder(compiler, func);
+		rc = compileMethodBuilder(&builder, &body);
+		record_arena(builder.arena()->stats());
+		bodies.frameless = rc == 0 && builder.frameless();
+	}
 	if (rc != 0) {
 		fprintf(stderr, "Failed to compile %p\n", func);
 		assert(0);
 	}
+	bodies.body = (CompiledFn)body;
+	return bodies;
+}
+
+void Interpreter::compile(Func* func) {
+	assert(func->installedBody() == nullptr);
+	func->install(_runtime.compile_body(func));
+}
+
+namespace {
+
+/// The interpreter running on this thread, and where to resume it after a stack overflow.
+thread_local Interpreter* activeInterpreter = nullptr;
+thread_local sigjmp_buf* activeRecovery = nullptr;
+
+struct sigaction previousSegvAction;
+struct sigaction previousBusAction;
+
+/// Resume the active interpreter if the fault is on its stack's guard pages.
+/// Any other fault goes to the handler that was installed before ours.
+void handleStackFault(int signal, siginfo_t* info, void* context) {
+	Interpreter* interpreter = activeInterpreter;
+	if (interpreter != nullptr && interpreter->isStackGuard(info->si_addr)) {
+		siglongjmp(*activeRecovery, 1);
+	}
+
+	const struct sigaction& previous = signal == SIGSEGV ? previousSegvAction : previousBusAction;
+	if (previous.sa_flags & SA_SIGINFO) {
+		previous.sa_sigaction(signal, info, context);
+	} else if (previous.sa_handler != SIG_IGN && previous.sa_handler != SIG_DFL) {
+		previous.sa_handler(signal);
+	} else {
+		// Re-raise with the default action, once this handler returns.
+		sigaction(signal, &previous, nullptr);
+	}
+}
+
+void installStackFaultHandler() {
+	static std::once_flag once;
+	std::call_once(once, [] {
+		struct sigaction action = {};
+		action.sa_sigaction = handleStackFault;
+		action.sa_flags = SA_SIGINFO | SA_NODEFER;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGSEGV, &action, &previousSegvAction);
+		sigaction(SIGBUS, &action, &previousBusAction);
+	});
+}
+
+}  // namespace
+
+Status Interpreter::guarded(void (Interpreter::*fn)(Func*), Func* target) {
+	if (activeInterpreter == this) {
+		if (_nesting == _options.maxCallDepth) {
+			_status = Status::STACK_OVERFLOW;
+			return _status;
+		}
+		_nesting += 1;
+		std::size_t depth = _segments.size();
+		enter_segment(target);
+		(this->*fn)(target);
+		if (_status == Status::OK) {
+			return_to_segment(depth);
+		}
+		_nesting -= 1;
+		return _status;
+	}
+
+	installStackFaultHandler();
+
+	Interpreter* outerInterpreter = activeInterpreter;
+	sigjmp_buf* outerRecovery = activeRecovery;
+	sigjmp_buf recovery;
+
+	// The handler runs with SA_NODEFER and an empty mask, so there is no signal mask to
+	// restore on the way out, and no syscall on the way in.
+	if (sigsetjmp(recovery, 0) == 0) {
+		activeRecovery = &recovery;
+		activeInterpreter = this;
+		enter_segment(target);
+		(this->*fn)(target);
+		if (_status == Status::OK) {
+			return_to_segment(0);
+		}
+	} else {
+		_status = Status::STACK_OVERFLOW;
+	}
+
+	Status status = _status;
+	if (status != Status::OK) {
+		leave_segments(0);
+		initialize();
+	}
+
+	activeInterpreter = outerInterpreter;
+	activeRecovery = outerRecovery;
+	return status;
+}
+
+void Interpreter::enter_segment(Func* target) {
+	if (!_options.segmentedStack) {
+		return;
+	}
+
+	std::size_t bytes = frame_bytes(target);
+	bool empty = _sp == _stack.base();
+	if (bytes == UNBOUNDED_DEPTH ? empty : bytes <= std::size_t(_stack.limit() - _sp)) {
+		return; // an unbounded frame gets a segment of its own, and may overflow it.
+	}
+
+	OMR::GuardedStack segment = _runtime.segments().acquire(bytes == UNBOUNDED_DEPTH ? 0 : bytes);
+	OMR::Model::Checks::poisonMemory(segment.base(), segment.size());
+
+	// The arguments are the first locals of target's frame, so they move with it. Any frame
+	// record stays behind: a RETURN finds it through _frame.
+	std::size_t argBytes = std::min(target->nparams * OMR::Model::SLOT_SIZE, std::size_t(_sp - _stack.base()));
+	std::uint8_t* args = _sp - argBytes;
+	std::memcpy(segment.base(), args, argBytes);
+	OMR::Model::Checks::poisonMemory(args, argBytes);
+
+	if (empty) {
+		// Nothing is live here, so there is nothing to come back to.
+		_runtime.segments().release(std::move(_stack));
+	} else {
+		_segments.push_back({std::move(_stack), args});
+	}
+
+	_stack = std::move(segment);
+	_sp = _stack.base() + argBytes;
+	_segmentLimit = segment_limit();
+}
+
+void Interpreter::return_to_segment(std::size_t depth) {
+	if (_segments.size() == depth) {
+		return;
+	}
+	assert(_segments.size() == depth + 1);
+
+	// A RETURN left its result in place of its frame record, on the saved segment, and
+	// moved _sp there. Anything else left on this segment replaces the arguments.
+	SavedSegment& saved = _segments.back();
+	std::uint8_t* sp = _sp;
+	if (_stack.base() <= _sp && _sp <= _stack.limit()) {
+		std::size_t bytes = _sp - _stack.base();
+		if (bytes > std::size_t(saved.stack.limit() - saved.sp)) {
+			_status = Status::STACK_OVERFLOW; // the results do not fit.
+			return;
+		}
+		std::memcpy(saved.sp, _stack.base(), bytes);
+		sp = saved.sp + bytes;
+	}
+
+	_runtime.segments().release(std::move(_stack));
+	_stack = std::move(saved.stack);
+	_sp = sp;
+	_segments.pop_back();
+	_segmentLimit = segment_limit();
+}
+
+void Interpreter::leave_segments(std::size_t depth) {
+	while (_segments.size() > depth) {
+		_runtime.segments().release(std::move(_stack));
+		_stack = std::move(_segments.back().stack);
+		_sp = _segments.back().sp;
+		_segments.pop_back();
+	}
+	_segmentLimit = segment_limit();
+}
+
+CompiledFn Interpreter::tier_up(Func* target) {
+	if (_options.compileQueue != nullptr) {
+		_options.compileQueue->enqueue(target);
+		return target->installedBody();
+	}
+	compile(target);
+	return target->installedBody();
 }
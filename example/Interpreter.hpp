@@ -6,12 +6,25 @@
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include <Example.hpp>
 #include <Instructions.hpp>
 #include <BytecodeMethodBuilder.hpp>
+#include <OMR/Model/Checks.hpp>
+#include <OMR/Model/SlotType.hpp>
+#include <OMR/Model/Trace.hpp>
+#include <OMR/Arena.hpp>
+#include <OMR/BytecodeInterpreterBuilder.hpp>
+#include <OMR/GuardedStack.hpp>
+#include <OMR/StackSegmentPool.hpp>
 
 class Interpreter;
+class BytecodeInterpreterCompiler;
+class CompileQueue;
 class JitTypes;
 class JitHelpers;
 struct Func;
@@ -24,87 +37,371 @@ using InterpretFn = void(*)(Interpreter*, Func*);
 ///
 using CompiledFn = void(*)(Interpreter*);
 
+/// A VM operand or local, as wide as a slot: int64, or int32 when OMR_MODEL_SLOT_SIZE is 4.
+///
+using SlotInt = OMR::Model::SlotInt;
+
+/// A JIT-compiled function with a native signature: SlotInt(Interpreter*, SlotInt...), one
+/// argument per parameter. Cast to the function's arity to call it, see Interpreter::call().
+///
+using NativeFn = void*;
+
+/// The bodies compiled for a function. See Runtime::compile_body().
+///
+struct CompiledBodies {
+	CompiledFn body = nullptr; //< called with the arguments and result on the operand stack.
+	NativeFn native = nullptr; //< or nullptr, if the function cannot have one.
+	bool frameless = false;    //< body pushes no frame record for the function.
+};
+
 /// Function header.
 ///
 struct Func {
 	Func() = default;
 
 	Func(std::size_t nlocals, std::size_t nparams)
-		: cbody(nullptr), nlocals(nlocals), nparams(nparams) {}
+		: cbody(nullptr), nbody(nullptr), nlocals(nlocals), nparams(nparams), invocations(0), backedges(0),
+		  frameBytes(0), queued(false), frameless(false) {}
+
+	/// How hot this function is. Compared against InterpreterOptions::jitThreshold.
+	std::size_t hotness() const { return invocations + backedges; }
+
+	/// The compiled body, or nullptr. Safe while another thread is installing one.
+	CompiledFn installedBody() const { return cbody.load(std::memory_order_acquire); }
+
+	/// The native body, or nullptr. Installed with, and no later than, the compiled body.
+	NativeFn installedNativeBody() const { return nbody.load(std::memory_order_acquire); }
 
-	CompiledFn cbody = nullptr; //< compiled body ptr.
+	/// Publish compiled bodies. Threads that see them also see the finished code.
+	void install(const CompiledBodies& bodies) {
+		frameless.store(bodies.frameless, std::memory_order_release);
+		nbody.store(bodies.native, std::memory_order_release);
+		cbody.store(bodies.body, std::memory_order_release);
+	}
+
+	std::atomic<CompiledFn> cbody{nullptr}; //< compiled body ptr.
+	std::atomic<NativeFn> nbody{nullptr};   //< native body ptr. See NativeFn.
 	std::size_t nlocals = 0;
 	std::size_t nparams = 0;
+	std::size_t invocations = 0; //< calls while interpreted, from the host or a CALL. Racy across threads.
+	std::size_t backedges = 0;   //< taken backwards branches, counted by the interpreter while tier-up is on. Racy across threads.
+	std::atomic<std::size_t> frameBytes{0}; //< stack bytes per activation, see frame_bytes(). 0 until computed.
+	std::atomic<bool> queued{false};        //< a background compile was requested, see CompileQueue.
+	std::atomic<bool> frameless{false};     //< the compiled body runs with no frame. Installed with it.
 	std::uint8_t body[]; //< bytecode body. trailing data.
 };
 
-/// The interpreter state.
-class Interpreter {
+/// A call's frame record. CALL stores one on the operand stack, just below the callee's
+/// arguments, and the callee's RETURN restores the caller's registers from it.
+struct Frame {
+	std::uint8_t* pc; //< the caller's pc: past the CALL if it is interpreted, where it resumes, else at it.
+	Func* fp;         //< the caller's function.
+	Frame* frame;     //< the caller's frame record, or nullptr if the caller was entered from the host.
+};
+
+using Dispatch = OMR::JitBuilder::Dispatch;
+
+/// The outcome of running a function.
+enum class Status {
+	OK,
+	STACK_OVERFLOW, //< the operand stack ran into a guard page, at either end, or calls nested too deep.
+};
+
+/// Options fixed when an Interpreter is constructed.
+struct InterpreterOptions {
+	Dispatch dispatch = Dispatch::SWITCH; //< dispatch strategy of the generated interpreter.
+	std::size_t jitThreshold = 0;         //< hotness at which run() compiles a function. 0 never compiles.
+	CompileQueue* compileQueue = nullptr; //< if set, hot functions are compiled here, in the background.
+	std::size_t stackSize = 64 * 1024;    //< operand stack size in bytes, rounded up to whole pages.
+	bool hugePages = false;               //< back the operand stack with huge pages, where supported.
+	bool segmentedStack = false;          //< start with one pooled segment, and chain more as calls need them.
+	bool cacheTop = true;                 //< the generated interpreter keeps the top of stack in a local.
+	std::size_t maxCallDepth = 2048;      //< most calls nested on the native stack, before an overflow. See guarded().
+};
+
+/// Process-wide state shared by every Interpreter: the generated interpreters, and the
+/// compilers that build them and compile functions. Created once, on first use, by whichever
+/// thread gets there first. Never destroyed, so it outlives any Interpreter or CompileQueue.
+class Runtime {
 public:
-	static constexpr std::size_t  STACK_SIZE = 4*8; //< in bytes
-	static constexpr std::uint8_t POISON     = 0x5e;
+	static constexpr std::size_t DISPATCH_COUNT = 2;
 
-	Interpreter() :
-		_compiler(), _sp(nullptr), _pc(nullptr), _startpc(nullptr), _fp(nullptr) {
-		std::memset(_stack, POISON, STACK_SIZE);
+	static constexpr std::size_t MAX_POOLED_STACKS = 64; //< whole stacks kept for reuse.
 
-		if (_interpret == nullptr) {
-			_interpret = compile_interpret_fn();
-		}
+	static Runtime& get();
+
+	Runtime(const Runtime&) = delete;
+
+	Runtime& operator=(const Runtime&) = delete;
+
+	/// The generated interpreter for a dispatch strategy, with or without top of stack caching,
+	/// and with or without back-edge counting. Compiled once, on first use.
+	InterpretFn interpret_fn(Dispatch dispatch, bool cacheTop, bool countBackEdges);
+
+	/// Compile func with compiler, without installing it. Any thread may call this: the
+	/// JitBuilder compiles are serialized, since JitBuilder is not thread safe, but the
+	/// bytecode analysis that comes before them is not.
+	///
+	/// A function whose frame never escapes, with at most NativeParameters::MAX parameters,
+	/// gets a native body, and its compiled body is a thin adapter to it. Any other gets a
+	/// compiled body only. Which is decided by frame_escapes(), before anything is compiled.
+	CompiledBodies compile_body(BytecodeMethodCompiler* compiler, Func* func);
+
+	/// Compile func with the runtime's own compiler.
+	CompiledBodies compile_body(Func* func) { return compile_body(&_compiler, func); }
+
+	/// Segments for segmented operand stacks, recycled across interpreters.
+	OMR::StackSegmentPool& segments() { return _segments; }
+
+	/// Whole operand stacks of the default size, recycled across interpreters.
+	OMR::StackSegmentPool& stacks() { return _stacks; }
+
+	/// The operand stack of a new interpreter with options. Segmented stacks, and stacks of
+	/// the default size without huge pages, come from a pool, so constructing an interpreter
+	/// does not usually map memory. Pooled stacks are not cleared.
+	OMR::GuardedStack acquire_stack(const InterpreterOptions& options);
+
+	/// Give back a stack from acquire_stack(), with the same options.
+	void release_stack(const InterpreterOptions& options, OMR::GuardedStack stack);
+
+	/// Arena use, summed over every compile so far: the generated interpreters, and compiled
+	/// functions. See OMR::Arena::Stats.
+	OMR::Arena::Stats arenaStats() const;
+
+private:
+	Runtime();
+
+	~Runtime() = delete;
+
+	InterpretFn compile_interpret_fn(Dispatch dispatch, bool cacheTop, bool countBackEdges);
+
+	/// Add one compile's arena use to the totals.
+	void record_arena(const OMR::Arena::Stats& stats);
+
+	std::mutex _jitLock; //< held for every JitBuilder compile.
+	BytecodeMethodCompiler _compiler;
+	std::unique_ptr<BytecodeInterpreterCompiler> _interpreterCompiler;
+	std::once_flag _interpretOnce[DISPATCH_COUNT * 4];
+	InterpretFn _interpretFns[DISPATCH_COUNT * 4]; //< indexed by dispatch, then cacheTop, then countBackEdges.
+	OMR::StackSegmentPool _segments;
+	OMR::StackSegmentPool _stacks;
+	mutable std::mutex _statsLock; //< guards _arenaStats.
+	OMR::Arena::Stats _arenaStats;
+};
 
+/// The interpreter state. Cheap to construct: everything shared lives in the Runtime.
+class Interpreter {
+public:
+	/// The operand stack is its own mapping, with a guard page at each end. Pushes and pops
+	/// are unchecked: overflow faults on a guard page, and the run returns STACK_OVERFLOW.
+	///
+	/// A segmented stack starts as a single segment from the runtime's pool. On entry to a
+	/// function, if the current segment cannot hold the function's whole frame, the stack
+	/// moves on to a fresh segment, and moves back when the function returns. The check is
+	/// once per entry, against the frame size found by frame_bytes(), never once per push.
+	/// A CALL in the generated interpreter checks inline, against the callee's cached
+	/// Func::frameBytes, and only goes through run() when it needs a new segment.
+	Interpreter(const InterpreterOptions& options = InterpreterOptions()) :
+		_runtime(Runtime::get()), _interpret(nullptr), _options(options),
+		_sp(nullptr), _pc(nullptr), _startpc(nullptr), _fp(nullptr), _frame(nullptr), _nesting(0), _status(Status::OK), _segmentLimit(nullptr),
+		_stack(_runtime.acquire_stack(options)),
+		_segments() {
+		OMR::Model::Checks::poisonMemory(_stack.base(), _stack.size());
+		_interpret = _runtime.interpret_fn(options.dispatch, options.cacheTop, options.jitThreshold != 0);
 		initialize();
 	}
 
-	void run(Func* target) {
-		if (target->cbody != nullptr) {
-			run_cbody(target);
-		} else {
-			interpret_body(target);
-		}
+	Interpreter(const Interpreter&) = delete;
+
+	Interpreter& operator=(const Interpreter&) = delete;
+
+	~Interpreter() {
+		leave_segments(0);
+		_runtime.release_stack(_options, std::move(_stack));
 	}
 
-	void interpret_body(Func* target) {
+	/// Run target, compiled if it has a body, else interpreted. An interpreted function is
+	/// compiled once it is hot. Without a compile queue, the call that finds it hot compiles
+	/// it and runs the compiled body. With one, the compile is queued, and the function is
+	/// interpreted until its body is installed.
+	/// Back-edges only heat a function up: a running loop is never switched over mid-call.
+	Status run(Func* target) {
+		return guarded(&Interpreter::do_run, target);
+	}
+
+	/// Set the hotness at which run() compiles a function. 0 disables tier-up. Switches to the
+	/// generated interpreter that counts back-edges, or to the one that does not.
+	void setJitThreshold(std::size_t threshold) {
+		_options.jitThreshold = threshold;
+		_interpret = _runtime.interpret_fn(_options.dispatch, _options.cacheTop, threshold != 0);
+	}
+
+	bool is_hot(const Func* target) const {
+		return _options.jitThreshold != 0 && target->hotness() >= _options.jitThreshold;
+	}
+
+	Status interpret_body(Func* target) {
 		assert(_interpret != nullptr);
-		do_interpret_body(target);
+		return guarded(&Interpreter::do_interpret_body, target);
 	}
 
+	/// Compile target on this thread, and install the body.
 	void compile(Func* target);
 
-	void run_cbody(Func* target) {
-		assert(target->cbody != nullptr);
-		do_run_cbody(target);
+	/// Call target with args as its arguments, each narrowed to a SlotInt, and set result to
+	/// its result.
+	///
+	/// With a native body, the arguments and result are passed in registers: the operand stack
+	/// is not touched. A native body never halts or calls, so the call is not guarded, and does
+	/// not tier anything up.
+	///
+	/// Otherwise, the arguments are pushed on the operand stack, and target is run, as run()
+	/// does. result is then the value on top of the stack, if the run left one, and the stack
+	/// is put back as it was. On overflow, result is untouched, and
+	/// the stack is reset.
+	template <typename... Args>
+	Status call(Func* target, std::int64_t& result, Args... args) {
+		assert(target->nparams == sizeof...(Args));
+		NativeFn native = target->installedNativeBody();
+		if (native != nullptr) {
+			using Fn = SlotInt(*)(Interpreter*, SlotIntArg<Args>...);
+			result = reinterpret_cast<Fn>(native)(this, SlotInt(args)...);
+			return Status::OK;
+		}
+
+		const SlotInt values[] = {SlotInt(args)..., 0};
+		std::size_t bytes = sizeof...(Args) * sizeof(SlotInt);
+		if (bytes > std::size_t(_stack.limit() - _sp)) {
+			return Status::STACK_OVERFLOW;
+		}
+		std::uint8_t* sp = _sp;
+		std::memcpy(_sp, values, bytes);
+		_sp += bytes;
+
+		Status status = run(target);
+		if (status == Status::OK) {
+			if (_sp >= sp + sizeof(SlotInt)) {
+				SlotInt value;
+				std::memcpy(&value, _sp - sizeof(SlotInt), sizeof(SlotInt));
+				result = value;
+			}
+			_sp = sp;
+		}
+		return status;
+	}
+
+	Status run_cbody(Func* target) {
+		assert(target->installedBody() != nullptr);
+		return guarded(&Interpreter::do_run_cbody, target);
 	}
 
+	/// The offset'th slot of the operand stack, counting from the bottom.
 	std::int64_t peek(std::size_t offset = 0) const {
-		return reinterpret_cast<const std::int64_t*>(_stack)[offset];
+		return reinterpret_cast<const SlotInt*>(_stack.base())[offset];
 	}
 
 	const std::uint8_t* sp() const { return _sp; }
 
+	/// True if address is in a guard page of this interpreter's operand stack.
+	bool isStackGuard(const void* address) const { return _stack.isGuard(address); }
+
+	const InterpreterOptions& options() const { return _options; }
+
+#if OMR_MODEL_TRACE == OMR_MODEL_TRACE_RING
+	/// Trace records written by generated code running on this interpreter.
+	const OMR::Model::TraceBuffer& trace() const { return _trace; }
+#endif
+
 private:
 	friend class JitHelpers;
 	friend class JitTypes;
 
-	static InterpretFn compile_interpret_fn();
+	template <typename> using SlotIntArg = SlotInt;
+
+	/// Call fn, catching stack overflow. On overflow, the stack is reset.
+	/// Nested calls, from generated code back into the interpreter, are caught by the outermost.
+	/// A nested call fails by setting _status and returning: the generated code that made it
+	/// returns in turn, and the outermost reports it. Only the fault handler jumps.
+	/// Each nests on the native stack, so past InterpreterOptions::maxCallDepth, a nested call
+	/// overflows, rather than the native stack. Generated code counts its direct calls into
+	/// compiled bodies in the same _nesting. Calls between interpreted functions do not nest:
+	/// the generated interpreter runs the callee in the same loop.
+	Status guarded(void (Interpreter::*fn)(Func*), Func* target);
 
-	static InterpretFn _interpret;
+	/// Compile a hot function now, or queue it. Returns the body, if it is ready.
+	CompiledFn tier_up(Func* target);
 
-	void initialize() { _sp = _stack; }
+	/// On a segmented stack, make room for target's frame, moving to a new segment if needed.
+	void enter_segment(Func* target);
+
+	/// After a run that called enter_segment() with depth segments saved, go back to the
+	/// segment it left, with the run's results in place of its arguments. If they do not fit,
+	/// sets _status, and leaves the segments to the outermost guarded().
+	void return_to_segment(std::size_t depth);
+
+	/// Drop every segment above the first depth saved ones, and whatever is on them.
+	void leave_segments(std::size_t depth);
+
+	void initialize() {
+		_sp = _stack.base();
+		_frame = nullptr;
+		_nesting = 0;
+		_status = Status::OK;
+		_segmentLimit = segment_limit();
+	}
+
+	/// The end of the current segment, for generated code to check a CALL's frame against.
+	/// nullptr if the stack is not segmented: a CALL never needs a new segment.
+	std::uint8_t* segment_limit() const {
+		return _options.segmentedStack ? _stack.limit() : nullptr;
+	}
+
+	void do_run(Func* target) {
+		CompiledFn body = target->installedBody();
+		if (body == nullptr) {
+			target->invocations += 1;
+			if (is_hot(target)) {
+				body = tier_up(target);
+			}
+		}
+
+		if (body != nullptr) {
+			body(this);
+		} else {
+			do_interpret_body(target);
+		}
+	}
 
 	void do_interpret_body(Func* target) {
 		_interpret(this, target);
 	}
 
 	void do_run_cbody(Func* target) {
-		target->cbody(this);
+		target->installedBody()(this);
 	}
 
-	BytecodeMethodCompiler _compiler;
+	Runtime& _runtime;
+	InterpretFn _interpret;
+	InterpreterOptions _options;
 	std::uint8_t* _sp;                //< Stack pointer. Pointer to top of stack.
 	std::uint8_t* _pc;                //< Program counter. Pointer to current bytecode.
 	std::uint8_t* _startpc;           //< pc at function entry. Used for absolute jumps.
 	Func* _fp;                        //< Function pointer. Pointer to current function.
-	std::uint8_t _stack[STACK_SIZE];
+	Frame* _frame;                    //< The current function's frame record. nullptr if entered from the host.
+	std::size_t _nesting;             //< guarded() calls under the outermost.
+	Status _status;                   //< set by a failed nested run. Generated code returns once it sees it.
+	std::uint8_t* _segmentLimit;      //< segment_limit(), kept up to date as the stack moves between segments.
+	/// A segment set aside while a callee runs on a newer one.
+	struct SavedSegment {
+		OMR::GuardedStack stack;
+		std::uint8_t* sp; //< below the callee's arguments, which moved to the newer segment.
+	};
+
+	OMR::GuardedStack _stack;              //< the current segment, or the whole stack.
+	std::vector<SavedSegment> _segments;   //< segments below the current one, innermost last.
+#if OMR_MODEL_TRACE == OMR_MODEL_TRACE_RING
+	OMR::Model::TraceBuffer _trace;
+#endif
 };
 
 #endif // INTERPRETER_HPP_
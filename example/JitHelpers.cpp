@@ -4,8 +4,12 @@
 #include "Interpreter.hpp"
 #include "JitHelpers.hpp"
 
+#include <OMR/Model/SlotType.hpp>
+
 #include "omrformatconsts.h"
 
+#include <vector>
+
 namespace JB = OMR::JitBuilder;
 
 /// Run a function in the interpreter.
@@ -13,12 +17,17 @@ void JitHelpers::interp_run(Interpreter* interpreter, Func* target) {
 	interpreter->run(target);
 }
 
+/// Compile a hot function, or queue it.
+CompiledFn JitHelpers::interp_tier_up(Interpreter* interpreter, Func* target) {
+	return interpreter->tier_up(target);
+}
+
 /// Print a mini trace statement.
 void JitHelpers::interp_trace(Interpreter* interpreter, Func* func) {
-	fprintf(stderr, "$$$ interpreter=%p func=%p pc=%p=%hhu sp=%p sp[-1]=%llu\n",
+	fprintf(stderr, "$$$ interpreter=%p func=%p pc=%p=%hhu sp=%p sp[-1]=%lld\n",
 		interpreter, func,
 		interpreter->_pc, *interpreter->_pc,
-		interpreter->_sp, reinterpret_cast<std::uint64_t*>(interpreter->_sp)[-1]
+		interpreter->_sp, static_cast<long long>(reinterpret_cast<OMR::Model::SlotInt*>(interpreter->_sp)[-1])
 	);
 }
 
@@ -63,6 +72,20 @@ void JitHelpers::define(JB::MethodBuilder* b) {
 		t->PointerTo(t->LookupStruct("Func"))
 	);
 
+	defhelper(b, "interp_tier_up", interp_tier_up, t->Address,
+		t->PointerTo(t->LookupStruct("Interpreter")),
+		t->PointerTo(t->LookupStruct("Func"))
+	);
+
+	// A compiled body, see CompiledFn. Called through its address.
+	b->DefineFunction(
+		const_cast<char*>("call_compiled"),
+		"<computed>", "<gen>",
+		nullptr,
+		t->NoType,
+		1, t->PointerTo(t->LookupStruct("Interpreter"))
+	);
+
 	defhelper(b, "interp_trace", interp_trace, t->NoType,
 		t->PointerTo(t->LookupStruct("Interpreter")),
 		t->PointerTo(t->LookupStruct("Func"))
@@ -91,3 +114,18 @@ void JitHelpers::define(JB::MethodBuilder* b) {
 		t->Int32
 	);
 }
+
+void JitHelpers::defineNative(JB::MethodBuilder* b, std::size_t nparams) {
+	JB::TypeDictionary* t = b->typeDictionary();
+
+	std::vector<JB::IlType*> types(nparams + 1, OMR::Model::slotType(t));
+	types[0] = t->PointerTo(t->LookupStruct("Interpreter"));
+
+	b->DefineFunction(
+		const_cast<char*>("call_native"),
+		"<computed>", "<gen>",
+		nullptr,
+		OMR::Model::slotType(t),
+		std::int32_t(types.size()), types.data()
+	);
+}
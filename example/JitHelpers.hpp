@@ -12,14 +12,23 @@ namespace JB = OMR::JitBuilder;
 class Interpreter;
 struct Func;
 
+using CompiledFn = void(*)(Interpreter*);
+
 class JitHelpers {
 public:
 	static void define(JB::MethodBuilder* b);
 
+	/// Define "call_native": the signature of a native body with nparams parameters.
+	/// See NativeFn.
+	static void defineNative(JB::MethodBuilder* b, std::size_t nparams);
+
 private:
 	/// Run a function in the interpreter.
 	static void interp_run(Interpreter* interpreter, Func* target);
 
+	/// Compile a hot function, or queue it. Returns its body, if it is ready.
+	static CompiledFn interp_tier_up(Interpreter* interpreter, Func* target);
+
 	/// Print a mini trace statement.
 	static void interp_trace(Interpreter* interpreter, Func* func);
 
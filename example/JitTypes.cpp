@@ -6,7 +6,9 @@
 namespace JB = OMR::JitBuilder;
 
 void JitTypes::define(JB::TypeDictionary* t) {
+	OMR::Model::defineTraceTypes(t);
 	JitTypes::defineFunc(t);
+	JitTypes::defineFrame(t);
 	JitTypes::defineInterpreter(t);
 }
 
@@ -15,15 +17,39 @@ void JitTypes::defineFunc(JB::TypeDictionary* t) {
 	t->DefineField("Func", "cbody",   t->Address, offsetof(Func, cbody));
 	t->DefineField("Func", "nlocals", t->Word,    offsetof(Func, nlocals));
 	t->DefineField("Func", "nparams", t->Word,    offsetof(Func, nparams));
+	t->DefineField("Func", "invocations", t->Word, offsetof(Func, invocations));
+	t->DefineField("Func", "backedges",   t->Word, offsetof(Func, backedges));
+	t->DefineField("Func", "frameBytes",  t->Word, offsetof(Func, frameBytes));
 	t->DefineField("Func", "body",    t->NoType,  offsetof(Func, body));
 	t->CloseStruct("Func");
 }
 
+void JitTypes::defineFrame(JB::TypeDictionary* t) {
+	t->DefineStruct("Frame");
+	t->DefineField("Frame", "pc",    t->pInt8,                              offsetof(Frame, pc));
+	t->DefineField("Frame", "fp",    t->PointerTo(t->LookupStruct("Func")), offsetof(Frame, fp));
+	t->DefineField("Frame", "frame", t->Address,                            offsetof(Frame, frame));
+	t->CloseStruct("Frame");
+}
+
 void JitTypes::defineInterpreter(JB::TypeDictionary* t) {
 	t->DefineStruct("Interpreter");
-	t->DefineField("Interpreter", "_sp",        t->pInt64,                             offsetof(Interpreter, _sp));
+	t->DefineField("Interpreter", "_sp",        t->PointerTo(OMR::Model::slotType(t)), offsetof(Interpreter, _sp));
 	t->DefineField("Interpreter", "_pc",        t->pInt8,                              offsetof(Interpreter, _pc));
 	t->DefineField("Interpreter", "_startpc",   t->pInt8,                              offsetof(Interpreter, _startpc));
 	t->DefineField("Interpreter", "_fp",        t->PointerTo(t->LookupStruct("Func")), offsetof(Interpreter, _fp));
+	t->DefineField("Interpreter", "_frame",     t->PointerTo(t->LookupStruct("Frame")), offsetof(Interpreter, _frame));
+	t->DefineField("Interpreter", "_interpret", t->Address,                            offsetof(Interpreter, _interpret));
+	t->DefineField("Interpreter", "_status",    t->Int32,                              offsetof(Interpreter, _status));
+	t->DefineField("Interpreter", "_nesting",   t->Word,                               offsetof(Interpreter, _nesting));
+	t->DefineField("Interpreter", "_segmentLimit", t->pInt8,                           offsetof(Interpreter, _segmentLimit));
+	// Options a CALL reads, from the Interpreter's copy.
+	t->DefineField("Interpreter", "jitThreshold", t->Word,
+		offsetof(Interpreter, _options) + offsetof(InterpreterOptions, jitThreshold));
+	t->DefineField("Interpreter", "maxCallDepth", t->Word,
+		offsetof(Interpreter, _options) + offsetof(InterpreterOptions, maxCallDepth));
+#if OMR_MODEL_TRACE == OMR_MODEL_TRACE_RING
+	t->DefineField("Interpreter", "_trace",     t->NoType,                             offsetof(Interpreter, _trace));
+#endif
 	t->CloseStruct("Interpreter");
 }
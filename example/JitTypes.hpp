@@ -10,6 +10,8 @@ public:
 private:
 	static void defineFunc(OMR::JitBuilder::TypeDictionary* t);
 
+	static void defineFrame(OMR::JitBuilder::TypeDictionary* t);
+
 	static void defineInterpreter(OMR::JitBuilder::TypeDictionary* t);
 };
 
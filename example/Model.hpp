@@ -2,17 +2,22 @@
 #define MODEL_HPP_
 
 #include "Interpreter.hpp"
+#include "Inliner.hpp"
 
 #include <OMR/Model/Value.hpp>
 #include <OMR/Model/OperandStack.hpp>
 #include <OMR/Model/OperandArray.hpp>
+#include <OMR/Model/OperandStackParameters.hpp>
+#include <OMR/Model/SlotType.hpp>
 #include <OMR/Model/Register.hpp>
 #include <OMR/Model/Pc.hpp>
 #include <OMR/Model/Builder.hpp>
+#include <OMR/Model/Trace.hpp>
 
 #include <OMR/BytecodeInterpreterBuilder.hpp>
 #include <OMR/BytecodeMethodBuilder.hpp>
 #include <OMR/ByteBuffer.hpp>
+#include <OMR/Arena.hpp>
 
 #include <VirtualMachineState.hpp>
 #include <TypeDictionary.hpp>
@@ -20,6 +25,7 @@
 
 #include <cstdint>
 #include <cassert>
+#include <cstring>
 #include <memory>
 
 namespace Model {
@@ -30,6 +36,7 @@ using OMR::Model::Mode;
 using OMR::Model::Builder;
 using OMR::Model::CBuilder;
 using OMR::Model::RBuilder;
+using OMR::Model::Trace;
 
 /// Current function metadata.
 /// Wrapper for accessing Func structures through the machine model.
@@ -60,7 +67,7 @@ public:
 	}
 
 	CValue<CompiledFn> cbody(OMR_UNUSED JB::IlBuilder* b) const {
-		return CValue<CompiledFn>::pack(_function->cbody);
+		return CValue<CompiledFn>::pack(_function->installedBody());
 	}
 
 	::Func* unpack() const { return _function; }
@@ -76,7 +83,7 @@ private:
 template <>
 class Func<Mode::REAL> {
 public:
-	Func() : _address(nullptr) {}
+	Func() : _address(nullptr), _countBackEdges(true) {}
 
 	void initialize(OMR_UNUSED JB::IlBuilder* b, RPtr<::Func> function) {
 		_address = function.unpack();
@@ -106,6 +113,27 @@ public:
 		);
 	}
 
+	/// Generate back-edge counting, see countBackEdge(). Only needed for tier-up.
+	void setCountBackEdges(bool count) { _countBackEdges = count; }
+
+	bool countsBackEdges() const { return _countBackEdges; }
+
+	/// Add taken, a 0 or 1 condition, to the function's back-edge counter. The update is a
+	/// plain load, add and store: threads running the same function can lose counts, which
+	/// only delays its tier-up.
+	void countBackEdge(JB::IlBuilder* b, JB::IlValue* taken) const {
+		assert(_countBackEdges);
+		JB::IlValue* count = b->LoadIndirect("Func", "backedges", _address);
+		JB::IlValue* inc = b->ConvertTo(b->typeDictionary()->Word, taken);
+		b->StoreIndirect("Func", "backedges", _address, b->Add(count, inc));
+	}
+
+	/// Make function the one running, as when the generated interpreter switches frames.
+	/// Every copy sees the switch, from here on.
+	void enter(JB::IlBuilder* b, JB::IlValue* function) {
+		b->StoreOver(_address, function);
+	}
+
 	JB::IlValue* unpack() const { return _address; }
 
 	void commit(JB::IlBuilder* b) {}
@@ -116,6 +144,7 @@ public:
 
 private:
 	JB::IlValue* _address;
+	bool _countBackEdges;
 };
 
 using RealFunc = Func<Mode::REAL>;
@@ -130,9 +159,9 @@ class Instruction<Mode::VIRT> {
 public:
 	Instruction() : _func() {}
 
-	void initialize(JB::IlBuilder* b, JB::IlValue* pc, CPtr<::Func> func) {
+	void initialize(JB::IlBuilder* b, JB::IlValue* pc, CPtr<::Func> func, const OMR::Model::FunctionData<Mode::VIRT>& data) {
 		_func.initialize(b, func);
-		_pc.initialize(b, pc, _func.body(b));
+		_pc.initialize(b, pc, _func.body(b), data.builders());
 	}
 
 	/// Get the address of the current function by loading from the PC.
@@ -145,8 +174,8 @@ public:
 	const OMR::Model::VirtPc& pc() const { return _pc; }
 
 	/// The current bytecode index.
-	CSize index(JB::BytecodeBuilder* b) const {
-		return CSize::pack(b->bcIndex());
+	CSize index(CBuilder* b) const {
+		return CSize::pack(_pc.offset(b));
 	}
 
 	CUInt64 immediateUInt64(Model::CBuilder* b, CSize offset) {
@@ -165,10 +194,19 @@ public:
 		return immediateInt64(b, CSize(b, 0));
 	}
 
+	/// An operand, encoded as an int64 immediate and narrowed to a slot.
+	CSlotInt immediateOperand(Model::CBuilder* b, CSize offset) {
+		return CSlotInt(b, SlotInt(read<std::int64_t>(b, offset.unpack())));
+	}
+
 	CSize immediateSize(Model::CBuilder* b, CSize offset) {
 		return CSize(b, read<std::int64_t>(b, offset.unpack()));
 	}
 
+	CPtr<::Func> immediateFunc(Model::CBuilder* b, CSize offset) {
+		return CPtr<::Func>::pack(read<::Func*>(b, offset.unpack()));
+	}
+
 	template <typename T>
 	CValue<T> immediate(Model::CBuilder* b, CSize offset) {
 		return CValue<T>::pack(read<T>(b, offset.unpack()));
@@ -179,11 +217,11 @@ public:
 		return CValue<T>::pack(read<T>(b));
 	}
 
-	void commit(JB::IlBuilder* b) {}
+	void commit(JB::IlBuilder* b) { _pc.commit(b); }
 
 	void reload(JB::IlBuilder* b) {}
 
-	void mergeInto(JB::IlBuilder* b, Instruction<Mode::VIRT>& dest) {}
+	void mergeInto(JB::IlBuilder* b, Instruction<Mode::VIRT>& dest) { _pc.mergeInto(b, dest._pc); }
 
 private:
 	template <typename T>
@@ -212,7 +250,7 @@ public:
 
 	Instruction() {}
 
-	void initialize(JB::IlBuilder* b, JB::IlValue* pc, RPtr<::Func> func) {
+	void initialize(JB::IlBuilder* b, JB::IlValue* pc, RPtr<::Func> func, OMR_UNUSED const OMR::Model::FunctionData<M>& data) {
 		_func.initialize(b, func);
 		_pc.initialize(b, pc, _func.body(b));
 	}
@@ -227,12 +265,26 @@ public:
 
 	const RealFunc& func() const { return _func; }
 
+	RealFunc& func() { return _func; }
+
 	const OMR::Model::RealPc& pc() const { return _pc; }
 
 	RSize index(RBuilder* b) const {
 		return RSize::pack(_pc.offset(b));
 	}
 
+	/// Move the pc past this instruction, of size bytes, without leaving the handler.
+	void skip(RBuilder* b, RSize size) {
+		JB::TypeDictionary* t = b->typeDictionary();
+		_pc.store(b, RPtr<std::uint8_t>::pack(b->IndexAt(t->pInt8, _pc.load(b).toIl(b), size.unpack())));
+	}
+
+	/// Start running function, from its first instruction. See RealFunc::enter().
+	void enter(JB::IlBuilder* b, JB::IlValue* function) {
+		_func.enter(b, function);
+		_pc.store(b, RPtr<std::uint8_t>::pack(b->StructFieldInstanceAddress("Func", "body", function)));
+	}
+
 	RUInt64 immediateUInt64(RBuilder* b, RSize offset) {
 		return RUInt64::pack(read<std::uint64_t>(b, offset.unpack()));
 	}
@@ -249,6 +301,15 @@ public:
 		return immediateInt64(b, RSize(b, 0));
 	}
 
+	/// An operand, encoded as an int64 immediate and narrowed to a slot.
+	RSlotInt immediateOperand(RBuilder* b, RSize offset) {
+		JB::IlValue* value = read<std::int64_t>(b, offset.unpack());
+		if (OMR::Model::SLOT_SIZE != sizeof(std::int64_t)) {
+			value = b->ConvertTo(OMR::Model::slotType(b->typeDictionary()), value);
+		}
+		return RSlotInt::pack(value);
+	}
+
 	RSize immediateSize(RBuilder* b, RSize offset) {
 		return RSize::pack(read<std::size_t>(b, offset.unpack()));
 	}
@@ -257,11 +318,18 @@ public:
 		return immediateSize(b, RSize(b, 0));
 	}
 
-	void commit(JB::IlBuilder* b) {}
+	RPtr<::Func> immediateFunc(RBuilder* b, RSize offset) {
+		JB::TypeDictionary* t = b->typeDictionary();
+		return RPtr<::Func>::pack(
+			b->ConvertTo(t->PointerTo(t->LookupStruct("Func")), read<std::uint64_t>(b, offset.unpack()))
+		);
+	}
+
+	void commit(JB::IlBuilder* b) { _pc.commit(b); }
 
 	void mergeInto(JB::IlBuilder* b, Instruction<Mode::REAL>& i) {}
 
-	void reload(JB::IlBuilder* b) {}
+	void reload(JB::IlBuilder* b) { _pc.reload(b); }
 
 private:
 	template <typename T>
@@ -270,17 +338,8 @@ private:
 
 		JB::IlValue* addr = b->IndexAt(t->pInt8, _pc.load(b).toIl(b), offset);
 		JB::IlValue* value = b->LoadAt(t->PointerTo(t->toIlType<T>()), addr);
-
-		b->Call("print_s", 1, b->Const((void*)"PC READ: pc="));
-		b->Call("print_x", 1, _pc.load(b).toIl(b));
-		b->Call("print_s", 1, b->Const((void*)" offset="));
-		b->Call("print_x", 1, offset);
-		b->Call("print_s", 1, b->Const((void*)" addr="));
-		b->Call("print_x", 1, addr);
-		b->Call("print_s", 1, b->Const((void*)" val="));
-		b->Call("print_u", 1, value);
-		b->Call("print_s", 1, b->Const((void*)"\n"));
-
+		Trace::value(b, "PC READ: addr=", addr);
+		Trace::value(b, "PC READ: val=", value);
 		return value;
 	}
 
@@ -288,6 +347,159 @@ private:
 	OMR::Model::RealPc _pc;
 };
 
+/// The PURE model's instruction: the bytecode at the cursor. Everything it reads is known.
+template <>
+class Instruction<Mode::PURE> {
+public:
+	Instruction() : _function(nullptr), _builders(nullptr) {}
+
+	void initialize(const ::Func* function, const OMR::Model::FunctionData<Mode::PURE>& data) {
+		_function = function;
+		_builders = data.builders();
+	}
+
+	PPtr<std::uint8_t> address(OMR_UNUSED JB::IlBuilder* b) const {
+		return PPtr<std::uint8_t>::pack(const_cast<std::uint8_t*>(&_function->body[_builders->cursor()]));
+	}
+
+	/// The current bytecode index.
+	PSize index(OMR_UNUSED JB::IlBuilder* b) const {
+		return PSize::pack(_builders->cursor());
+	}
+
+	const ::Func* function() const { return _function; }
+
+	PInt64 immediateInt64(JB::IlBuilder* b, PSize offset) {
+		return PInt64::pack(read<std::int64_t>(b, offset.unpack()));
+	}
+
+	/// An operand, encoded as an int64 immediate and narrowed to a slot.
+	PSlotInt immediateOperand(JB::IlBuilder* b, PSize offset) {
+		return PSlotInt::pack(SlotInt(read<std::int64_t>(b, offset.unpack())));
+	}
+
+	PSize immediateSize(JB::IlBuilder* b, PSize offset) {
+		return PSize::pack(read<std::size_t>(b, offset.unpack()));
+	}
+
+	PPtr<::Func> immediateFunc(JB::IlBuilder* b, PSize offset) {
+		return PPtr<::Func>::pack(read<::Func*>(b, offset.unpack()));
+	}
+
+	void commit(OMR_UNUSED JB::IlBuilder* b) {}
+
+	void reload(OMR_UNUSED JB::IlBuilder* b) {}
+
+	void mergeInto(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED Instruction<Mode::PURE>& dest) {}
+
+private:
+	template <typename T>
+	T read(JB::IlBuilder* b, std::size_t offset) {
+		T value;
+		std::memcpy(&value, address(b).unpack() + offset, sizeof(value));
+		return value;
+	}
+
+	const ::Func* _function;
+	JB::BytecodeBuilderTable* _builders;
+};
+
+/// The interpreter's call registers: the current function, and the current frame record.
+/// They are only touched on entry, at calls and at returns, so in every mode they live in
+/// memory, and commit, reload and merge have nothing to do.
+class FrameChain {
+public:
+	/// Operand stack slots taken by one frame record.
+	static constexpr std::size_t RECORD_SLOTS = sizeof(::Frame) / OMR::Model::SLOT_SIZE;
+
+	FrameChain() : _interpreter(nullptr) {}
+
+	void initialize(OMR_UNUSED JB::IlBuilder* b, JB::IlValue* interpreter) {
+		_interpreter = interpreter;
+	}
+
+	JB::IlValue* interpreter() const { return _interpreter; }
+
+	/// Make function the current function.
+	void enter(JB::IlBuilder* b, JB::IlValue* function) {
+		b->StoreIndirect("Interpreter", "_fp", _interpreter, function);
+	}
+
+	/// Save the caller's registers in the record at address, and make it the current record.
+	void push(JB::IlBuilder* b, JB::IlValue* address) {
+		JB::IlValue* record = recordPointer(b, address);
+		b->StoreIndirect("Frame", "pc",    record, b->LoadIndirect("Interpreter", "_pc",    _interpreter));
+		b->StoreIndirect("Frame", "fp",    record, b->LoadIndirect("Interpreter", "_fp",    _interpreter));
+		b->StoreIndirect("Frame", "frame", record, b->LoadIndirect("Interpreter", "_frame", _interpreter));
+		b->StoreIndirect("Interpreter", "_frame", _interpreter, record);
+	}
+
+	/// The current record's address, which is where the caller's stack stood before the call's
+	/// arguments. nullptr in a function entered from the host, which has no caller.
+	JB::IlValue* record(JB::IlBuilder* b) {
+		return b->LoadIndirect("Interpreter", "_frame", _interpreter);
+	}
+
+	/// Restore the caller's registers from the current record, found by record().
+	void pop(JB::IlBuilder* b, JB::IlValue* record) {
+		b->StoreIndirect("Interpreter", "_pc",    _interpreter, b->LoadIndirect("Frame", "pc",    record));
+		b->StoreIndirect("Interpreter", "_fp",    _interpreter, b->LoadIndirect("Frame", "fp",    record));
+		b->StoreIndirect("Interpreter", "_frame", _interpreter, b->LoadIndirect("Frame", "frame", record));
+	}
+
+	/// @group The generated interpreter's entry frame
+	/// The frame the generated interpreter was entered in, by the host or by compiled code.
+	/// Its RETURN leaves the interpreter. Any other frame was pushed by a CALL in the same
+	/// loop, and its RETURN resumes the caller there. REAL only.
+	/// @{
+
+	/// Take the current record, and the locals at locals, as the entry frame's.
+	void markEntry(JB::IlBuilder* b, JB::IlValue* locals) {
+		JB::TypeDictionary* t = b->typeDictionary();
+		b->Store("entry_frame", record(b));
+		b->Store("entry_locals", b->ConvertTo(t->PointerTo(OMR::Model::slotType(t)), locals));
+	}
+
+	/// The entry frame's record.
+	JB::IlValue* entry(JB::IlBuilder* b) {
+		return b->Load("entry_frame");
+	}
+
+	/// The locals of the frame whose record is record: just above it, but for the entry frame's,
+	/// which may have moved to a new segment without it.
+	JB::IlValue* locals(JB::IlBuilder* b, JB::IlValue* record) {
+		JB::TypeDictionary* t = b->typeDictionary();
+		JB::IlType* ptype = t->PointerTo(OMR::Model::slotType(t));
+		JB::IlBuilder* entered = nullptr;
+		JB::IlBuilder* called = nullptr;
+		b->IfThenElse(&entered, &called, b->EqualTo(record, entry(b)));
+		entered->Store("frame_locals", entered->Load("entry_locals"));
+		called->Store("frame_locals",
+			called->IndexAt(ptype, called->ConvertTo(ptype, record), called->ConstInt64(RECORD_SLOTS)));
+		return b->Load("frame_locals");
+	}
+
+	/// @}
+	///
+
+	void commit(OMR_UNUSED JB::IlBuilder* b) {}
+
+	void reload(OMR_UNUSED JB::IlBuilder* b) {}
+
+	void mergeInto(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED FrameChain& dest) {}
+
+private:
+	static JB::IlValue* recordPointer(JB::IlBuilder* b, JB::IlValue* address) {
+		JB::TypeDictionary* t = b->typeDictionary();
+		return b->ConvertTo(t->PointerTo(t->LookupStruct("Frame")), address);
+	}
+
+	JB::IlValue* _interpreter;
+};
+
+/// Builds the entry of a function with no frame. Defined after Machine, for VIRT only.
+template <Mode M> struct FramelessEntry;
+
 template <Mode M>
 class Machine final : public JB::VirtualMachineState {
 public:
@@ -297,39 +509,95 @@ public:
 
 		void setFunction(Ptr<M, ::Func> function) { _function = function; }
 
+		/// The arena of the compilation. Machine copies and their slots are allocated here.
+		void setArena(OMR::Arena* arena) { _arena = arena; }
+
+		/// Build the machine of a function entered in a frame of its own, on the operand stack.
 		Machine<M>* create(JB::IlBuilder* b, OMR::Model::FunctionData<M>& data) {
+			Model::Machine<M>* machine = createRegisters(b, data);
+
+			// The parameters are the first locals: the caller left the arguments on the stack.
+			OMR::Model::Size<M> nparams = machine->instruction.func().nparams(b);
+			OMR::Model::Size<M> nlocals = machine->instruction.func().nlocals(b);
+
+			machine->frames.enter(b, _function.toIl(b));
+			JB::IlValue* localsAddr = machine->stack.reserveFrame(b, nparams, nlocals);
+			machine->locals.initialize(b, OMR::Model::slotType(b->typeDictionary()), localsAddr, nlocals, _arena);
+
+			return machine;
+		}
+
+		/// Build the machine of a function whose frame never escapes: see ValueAnalysis. Its
+		/// locals live only in IL values, with no frame on the operand stack, and its operands
+		/// are never stored, but for its result. If native, the arguments are the parameters
+		/// named by NativeParameters, and RETURN returns the result, rather than storing it.
+		/// The generated interpreter runs every function in a frame, so VIRT only.
+		Machine<M>* createFrameless(JB::IlBuilder* b, OMR::Model::FunctionData<M>& data, bool native) {
+			static_assert(M == Mode::VIRT, "only compiled bodies can run without a frame");
+
+			Model::Machine<M>* machine = createRegisters(b, data);
+			machine->_native = native;
+			machine->_frameless = true;
+
+			OMR::Model::Size<M> nparams = machine->instruction.func().nparams(b);
+			OMR::Model::Size<M> nlocals = machine->instruction.func().nlocals(b);
+			FramelessEntry<M>::initialize(b, *machine, nparams, nlocals, native, _arena);
+
+			return machine;
+		}
+
+	private:
+		/// A machine whose registers and operand stack are set up, with no locals yet.
+		Machine<M>* createRegisters(JB::IlBuilder* b, OMR::Model::FunctionData<M>& data) {
 
 			JB::TypeDictionary* t = b->typeDictionary();
 
 			assert(_interpreter != nullptr);
+			assert(_arena != nullptr);
 	
 			Model::Machine<M>* machine = new Model::Machine<M>(data);
+			machine->_arena = _arena;
 
 			JB::IlValue* pcAddr      = b->StructFieldInstanceAddress("Interpreter", "_pc",      _interpreter);
 			JB::IlValue* spAddr      = b->StructFieldInstanceAddress("Interpreter", "_sp",      _interpreter);
-			JB::IlValue* fpAddr      = b->StructFieldInstanceAddress("Interpreter", "_fp",      _interpreter);
 			JB::IlValue* startPcAddr = b->StructFieldInstanceAddress("Interpreter", "_startpc", _interpreter);
 
-			machine->instruction.initialize(b, pcAddr, _function);
+			machine->instruction.initialize(b, pcAddr, _function, data);
 
-			machine->stack.initialize(b, t->Int64, spAddr);
+			machine->stack.initialize(b, OMR::Model::slotType(t), spAddr, _arena);
 
 			machine->control.initialize(b, pcAddr);
-	
-			OMR::Model::Size<M> nlocals = machine->instruction.func().nlocals(b);
-			JB::IlValue* localsAddr = machine->stack.reserve64(b, nlocals);
-			machine->locals.initialize(b, t->Int64, localsAddr, nlocals);
+
+			machine->frames.initialize(b, _interpreter);
 
 			return machine;
 		}
 
-	private:
 		JB::IlValue* _interpreter = nullptr;
+		OMR::Arena* _arena = nullptr;
 		Ptr<M, ::Func> _function;
 		JB::BytecodeBuilderTable* _builders = nullptr;
 	};
 
-	Machine(OMR::Model::FunctionData<M>& data) : control(data) {}
+	Machine(OMR::Model::FunctionData<M>& data)
+		: control(data), _arena(nullptr), _native(false), _frameless(false), _inlineDepth(0) {}
+
+	/// The machine of function, inlined into caller: see Inliner. It shares the caller's
+	/// registers, and starts from a copy of its operand stack, to be handed back once the
+	/// callee returns. The arguments are popped into locals with no memory behind them.
+	/// VIRT only.
+	Machine(JB::IlBuilder* b, OMR::Model::FunctionData<M>& data, const Machine<M>& caller, ::Func* function)
+		: instruction(), stack(caller.stack), locals(), control(data), frames(caller.frames),
+		  _arena(caller._arena), _native(false), _frameless(false), _inlineDepth(caller._inlineDepth + 1) {
+		JB::IlValue* pcAddr = b->StructFieldInstanceAddress("Interpreter", "_pc", frames.interpreter());
+		instruction.initialize(b, pcAddr, CPtr<::Func>::pack(function), data);
+		control.initialize(b, pcAddr);
+		locals.initializeUnbacked(b, OMR::Model::slotType(b->typeDictionary()),
+			CSize::pack(function->nlocals), KSlotInt::known(0), _arena);
+		for (std::size_t i = function->nparams; i > 0; --i) {
+			locals.set(b, CSize::pack(i - 1), stack.pop(b));
+		}
+	}
 
 	Machine(const Machine&) = default;
 
@@ -339,18 +607,35 @@ public:
 		instruction.commit(b);
 		stack.commit(b);
 		locals.commit(b);
+		frames.commit(b);
 	}
 
 	void mergeInto(JB::IlBuilder* b, Machine<M>& dest) {
 		instruction.mergeInto(b, dest.instruction);
 		stack.mergeInto(b, dest.stack);
 		locals.mergeInto(b, dest.locals);
+		frames.mergeInto(b, dest.frames);
 	}
 
 	void reload(JB::IlBuilder* b) {
 		instruction.reload(b);
 		stack.reload(b);
 		locals.reload(b);
+		frames.reload(b);
+	}
+
+	/// Give every known value its IL, in b. Call before control leaves a block: known
+	/// values do not cross block boundaries. VIRT only.
+	void materializeKnown(JB::IlBuilder* b) {
+		stack.materializeKnown(b);
+		locals.materializeKnown(b);
+	}
+
+	/// Join other into this state. Returns true if this state changed. PURE only.
+	bool join(const Machine<M>& other) {
+		bool changed = stack.join(other.stack);
+		changed = locals.join(other.locals) || changed;
+		return changed;
 	}
 
 	/// @group VirtualMachineState implementation
@@ -361,41 +646,92 @@ public:
 	}
 
 	virtual void MergeInto(JB::VirtualMachineState* dest, JB::IlBuilder* b) override final {
-		fprintf(stderr, "@@@ Machine %p MergeInto %p\n", this, dest);
 		mergeInto(b, *reinterpret_cast<Model::Machine<M>*>(dest));
 	}
 
+	/// Copies live in the compilation's arena, and are never deleted.
 	virtual JB::VirtualMachineState* MakeCopy() override final {
-		auto copy = new Model::Machine<M>(*this);
-		fprintf(stderr, "@@@ Machine this=%p MakeCopy copy=%p\n", this, copy);
-		return copy;
+		return _arena->create<Model::Machine<M>>(*this);
 	}
 
 	/// @}
 	///
 
+	/// The arena of the compilation.
+	OMR::Arena* arena() const { return _arena; }
+
+	/// True if this is the machine of a native body. See Factory::createFrameless().
+	bool native() const { return _native; }
+
+	/// True if the function was entered with no frame. See Factory::createFrameless().
+	bool frameless() const { return _frameless; }
+
+	/// How many calls down this machine's function is inlined. 0 if it is not. VIRT only.
+	std::size_t inlineDepth() const { return _inlineDepth; }
+
 	Instruction<M> instruction;
 	OMR::Model::OperandStack<M> stack;
 	OMR::Model::OperandArray<M> locals;
 	OMR::Model::ControlFlow<M> control;
+	FrameChain frames;
 
 private:
 	friend class Factory;
 
-	Machine() {}
+	Machine() : _arena(nullptr), _native(false), _frameless(false), _inlineDepth(0) {}
+
+	OMR::Arena* _arena;
+	bool _native;
+	bool _frameless;
+	std::size_t _inlineDepth;
 };
 
 using RealMachine = Machine<Mode::REAL>;
 using VirtMachine = Machine<Mode::VIRT>;
+using PureMachine = Machine<Mode::PURE>;
+
+/// The entry of a function built without a frame. See Machine::Factory::createFrameless().
+template <>
+struct FramelessEntry<Mode::VIRT> {
+	/// The arguments are loaded into unbacked locals: from the native parameters, or from
+	/// the operand stack, where they stay, under the operands, which start out empty. Nothing
+	/// needs the current function to be entered: RETURN restores the caller's registers from
+	/// its frame record, or, in a native body, just returns.
+	///
+	/// The other locals start out as a known 0. The entry state becomes the first block's
+	/// entry state, which a loop back to index 0 merges into, so it is materialized.
+	static void initialize(JB::IlBuilder* b, VirtMachine& machine, CSize nparams, CSize nlocals,
+		bool native, OMR::Arena* arena) {
+		JB::IlType* type = OMR::Model::slotType(b->typeDictionary());
+		machine.locals.initializeUnbacked(b, type, nlocals, KSlotInt::known(0), arena);
+
+		if (native) {
+			loadArguments(b, machine, OMR::Model::NativeParameters(), nparams);
+		} else {
+			OMR::Model::OperandStackParameters<Mode::VIRT> parameters;
+			parameters.initialize(b, machine.stack, nparams);
+			loadArguments(b, machine, parameters, nparams);
+		}
+		machine.materializeKnown(b);
+	}
+
+private:
+	template <typename ParametersT>
+	static void loadArguments(JB::IlBuilder* b, VirtMachine& machine, ParametersT parameters, CSize nparams) {
+		for (std::size_t i = 0; i < nparams.unpack(); ++i) {
+			machine.locals.set(b, CSize::pack(i), parameters.get(b, CSize::pack(i)));
+		}
+	}
+};
 
 ///
 /// Runtime control flow operations.
 ///
 
 inline void halt(Model::RBuilder* b, RealMachine& machine) {
-	b->Call("print_s", 1, b->Const((void*)"$$$ machine halt\n"));
+	Trace::message(b, "$$$ machine halt\n");
+	machine.commit(b);
 	b->GotoEnd();
-	// machine.commit(b);
 	b->End()->Return();
 }
 
@@ -405,34 +741,182 @@ inline void next(Model::RBuilder* b, RealMachine& machine, RSize offset) {
 	JB::IlValue* index = machine.instruction.index(b).unpack();
 	JB::IlValue* target = b->Add(index, off);
 
-	b->Call("print_s", 1, b->Const((void*)"$$$ machine next: offset="));
-	b->Call("print_u", 1, off);
-	b->Call("print_s", 1, b->Const((void*)" target-index="));
-	b->Call("print_u", 1, target);
-	b->Call("print_s", 1, b->Const((void*)"\n"));
+	Trace::value(b, "$$$ machine next: offset=", off);
+	Trace::value(b, "$$$ machine next: target-index=", target);
 
 	machine.control.next(b, target);
 }
 
-/// Relative conditional if, signed offset.
-inline void ifCmpNotEqualZero(Model::RBuilder* b, RealMachine& machine, JB::IlValue* cond, RInt64 offset) {
-
+/// Relative conditional if, signed offset. Returns true: control may fall through.
+inline bool ifCmpNotEqualZero(Model::RBuilder* b, RealMachine& machine, RSlotInt condition, RInt64 offset) {
+	JB::IlValue* cond = condition.unpack();
 	JB::IlValue* off = offset.unpack();
 	JB::IlValue* index = machine.instruction.index(b).unpack();
-	JB::IlValue* pc = machine.instruction.address(b).unpack();
 	JB::IlValue* target = b->Add(index, off);
-	JB::IlValue* targetpc = b->Add(pc, off);
-
-	b->Call("print_s", 1, b->Const((void*)"$$$ machine ifCmpNotEqualZero offset="));
-	b->Call("print_u", 1, off);
-	b->Call("print_s", 1, b->Const((void*)" target-pc="));
-	b->Call("print_u", 1, targetpc);
-	b->Call("print_s", 1, b->Const((void*)" target-index="));
-	b->Call("print_u", 1, target);
-	b->Call("print_s", 1, b->Const((void* )"\n"));
+	Trace::value(b, "$$$ machine ifCmpNotEqualZero offset=", off);
+	Trace::value(b, "$$$ machine ifCmpNotEqualZero target-index=", target);
+
+	// Count the branch if it is taken and backwards, without branching on it twice.
+	if (machine.instruction.func().countsBackEdges()) {
+		JB::IlValue* taken = b->NotEqualTo(cond, OMR::Model::constant(b, SlotInt(0)));
+		JB::IlValue* backwards = b->LessThan(off, b->ConstInt64(1));
+		machine.instruction.func().countBackEdge(b, b->And(taken, backwards));
+	}
 
 	// _pcReg.store(b, CPtr<std::uint8_t>::pack(targetPc));
 	machine.control.IfCmpNotEqualZero(b, cond, target);
+	return true;
+}
+
+/// Return at once if a call failed: the interpreter's status says so. Nothing is committed:
+/// the outermost run resets the stack.
+inline void check_status(JB::IlBuilder* b, JB::IlValue* interpreter) {
+	JB::IlBuilder* failed = nullptr;
+	JB::IlValue* status = b->LoadIndirect("Interpreter", "_status", interpreter);
+	b->IfThen(&failed, b->NotEqualTo(status, b->ConstInt32(std::int32_t(Status::OK))));
+	Trace::message(failed, "$$$ machine call failed\n");
+	failed->Return();
+}
+
+/// Run callee, with the frame already set up, see call(). The call goes through
+/// Interpreter::run(), as a call from the host does: the callee is counted, and tiered up when
+/// hot, its frame gets a new stack segment if it needs one, and the nesting is bounded.
+inline void call_body(JB::IlBuilder* b, JB::IlValue* interpreter, JB::IlValue* callee) {
+	b->Call("interp_run", 2, interpreter, callee);
+	check_status(b, interpreter);
+}
+
+/// Call a compiled body directly, with the frame already set up. Each such call nests on the
+/// native stack, so it is counted in the interpreter's nesting, and past
+/// InterpreterOptions::maxCallDepth, fails with a stack overflow, as a nested run() does.
+inline void call_compiled(JB::IlBuilder* b, JB::IlValue* interpreter, JB::IlValue* body) {
+	JB::IlValue* nesting = b->LoadIndirect("Interpreter", "_nesting", interpreter);
+	JB::IlBuilder* deep = nullptr;
+	b->IfThen(&deep, b->UnsignedGreaterOrEqualTo(nesting, b->LoadIndirect("Interpreter", "maxCallDepth", interpreter)));
+	deep->StoreIndirect("Interpreter", "_status", interpreter, deep->ConstInt32(std::int32_t(Status::STACK_OVERFLOW)));
+	deep->Return();
+
+	b->StoreIndirect("Interpreter", "_nesting", interpreter, b->Add(nesting, b->ConstInt64(1)));
+	b->ComputedCall("call_compiled", 2, body, interpreter);
+	b->StoreIndirect("Interpreter", "_nesting", interpreter, nesting);
+	check_status(b, interpreter);
+}
+
+/// True if the interpreter's stack is segmented, and callee's frame may not fit on the current
+/// segment: its size is not known yet, or more than is left. Interpreter::enter_segment()
+/// decides exactly, in run().
+inline JB::IlValue* needs_segment(JB::IlBuilder* b, JB::IlValue* interpreter, JB::IlValue* callee) {
+	JB::TypeDictionary* t = b->typeDictionary();
+	JB::IlValue* limit = b->LoadIndirect("Interpreter", "_segmentLimit", interpreter);
+	b->Store("call_needs_segment", b->ConstInt32(0));
+
+	JB::IlBuilder* segmented = nullptr;
+	b->IfThen(&segmented, b->NotEqualTo(limit, b->ConstAddress(nullptr)));
+	JB::IlValue* bytes = segmented->LoadIndirect("Func", "frameBytes", callee);
+	JB::IlValue* sp = segmented->LoadIndirect("Interpreter", "_sp", interpreter);
+	JB::IlValue* room = segmented->Sub(segmented->ConvertTo(t->Word, limit), segmented->ConvertTo(t->Word, sp));
+	segmented->Store("call_needs_segment", segmented->Or(
+		segmented->EqualTo(bytes, segmented->ConstInt64(0)),
+		segmented->UnsignedGreaterThan(bytes, room)));
+
+	return b->Load("call_needs_segment");
+}
+
+/// Count a call to callee, which has no compiled body, as Interpreter::run() does. With tier-up
+/// on, a call that finds it hot compiles it, or queues it: the body, if it is ready, replaces
+/// the one in "call_target_body".
+inline void count_call(JB::IlBuilder* b, RealMachine& machine, JB::IlValue* interpreter, JB::IlValue* callee) {
+	JB::IlValue* invocations = b->Add(b->LoadIndirect("Func", "invocations", callee), b->ConstInt64(1));
+	b->StoreIndirect("Func", "invocations", callee, invocations);
+
+	if (machine.instruction.func().countsBackEdges()) {
+		JB::IlValue* hotness = b->Add(invocations, b->LoadIndirect("Func", "backedges", callee));
+		JB::IlBuilder* hot = nullptr;
+		b->IfThen(&hot, b->UnsignedGreaterOrEqualTo(hotness, b->LoadIndirect("Interpreter", "jitThreshold", interpreter)));
+		hot->Store("call_target_body", hot->Call("interp_tier_up", 2, interpreter, callee));
+	}
+}
+
+/// Call callee. Its arguments, the top nparams operands, become the first locals of its frame,
+/// which sits on this operand stack, just above a frame record holding the caller's registers:
+/// its pc is the next instruction's. Its RETURN pops the frame, leaves the result in place of
+/// the arguments, and the caller resumes there.
+///
+/// A compiled callee is called directly. An interpreted one is counted, and tiered up if hot,
+/// inline, and is then run in this same loop: the interpreter switches to the callee's code and
+/// frame, and dispatches. Only a callee that may need a new stack segment goes through a
+/// nested run, see call_body().
+inline void call(Model::RBuilder* b, RealMachine& machine, RPtr<::Func> callee, RSize size) {
+	JB::IlValue* interpreter = machine.frames.interpreter();
+	JB::IlValue* function = callee.unpack();
+
+	machine.instruction.skip(b, size);
+	RSize nparams = RSize::pack(b->LoadIndirect("Func", "nparams", function));
+	JB::IlValue* record = machine.stack.insert(b, nparams, RSize(b, FrameChain::RECORD_SLOTS));
+	machine.commit(b); // the record saves the pc, and the callee reads the sp.
+	machine.frames.push(b, record);
+	Trace::value(b, "$$$ machine call: callee=", function);
+
+	JB::IlBuilder* slow = nullptr;
+	JB::IlBuilder* fast = nullptr;
+	b->IfThenElse(&slow, &fast, needs_segment(b, interpreter, function));
+
+	call_body(slow, interpreter, function);
+	machine.reload(slow);
+
+	fast->Store("call_target_body", fast->LoadIndirect("Func", "cbody", function));
+	JB::IlBuilder* uncompiled = nullptr;
+	fast->IfThen(&uncompiled, fast->EqualTo(fast->Load("call_target_body"), fast->ConstAddress(nullptr)));
+	count_call(uncompiled, machine, interpreter, function);
+
+	JB::IlBuilder* compiled = nullptr;
+	JB::IlBuilder* interpreted = nullptr;
+	fast->IfThenElse(&compiled, &interpreted, fast->NotEqualTo(fast->Load("call_target_body"), fast->ConstAddress(nullptr)));
+
+	call_compiled(compiled, interpreter, compiled->Load("call_target_body"));
+	machine.reload(compiled);
+
+	Trace::message(interpreted, "$$$ machine call: interpreted\n");
+	machine.frames.enter(interpreted, function);
+	machine.instruction.enter(interpreted, function);
+	RSize nlocals = RSize::pack(interpreted->LoadIndirect("Func", "nlocals", function));
+	JB::IlValue* locals = machine.stack.reserveFrame(interpreted, nparams, nlocals);
+	machine.locals.rebase(interpreted, locals, nlocals);
+}
+
+/// Return from a called function: pop its frame, restore the caller's registers, and push the
+/// result where the arguments were. An interpreted caller, called in this loop, resumes at
+/// the next instruction. Otherwise the interpreter returns: to compiled code, or to the host.
+/// A function entered from the host has no caller: it leaves the result on the stack and
+/// stops, as HALT does.
+inline void ret(Model::RBuilder* b, RealMachine& machine) {
+	RSlotInt value = machine.stack.pop(b);
+	JB::IlValue* record = machine.frames.record(b);
+	JB::IlBuilder* leave = nullptr;
+	JB::IlBuilder* resume = nullptr;
+	b->IfThenElse(&leave, &resume, b->EqualTo(record, machine.frames.entry(b)));
+
+	JB::IlBuilder* caller = nullptr;
+	JB::IlBuilder* host = nullptr;
+	leave->IfThenElse(&caller, &host, leave->NotEqualTo(record, leave->ConstAddress(nullptr)));
+	machine.instruction.commit(host); // the pc stays at the RETURN, as it does at a HALT.
+	machine.frames.pop(caller, record);
+	machine.stack.reset(caller, record);
+	machine.stack.push(leave, value);
+	machine.stack.commit(leave); // not the pc: the caller's was restored above.
+	Trace::message(leave, "$$$ machine return: leave\n");
+	leave->Return();
+
+	JB::IlValue* interpreter = machine.frames.interpreter();
+	machine.frames.pop(resume, record);
+	machine.stack.reset(resume, record);
+	machine.stack.push(resume, value);
+	machine.instruction.reload(resume);
+	JB::IlValue* function = resume->LoadIndirect("Interpreter", "_fp", interpreter);
+	machine.instruction.func().enter(resume, function);
+	RSize nlocals = RSize::pack(resume->LoadIndirect("Func", "nlocals", function));
+	machine.locals.rebase(resume, machine.frames.locals(resume, machine.frames.record(resume)), nlocals);
+	Trace::message(resume, "$$$ machine return: resume\n");
 }
 
 ///
@@ -440,28 +924,68 @@ inline void ifCmpNotEqualZero(Model::RBuilder* b, RealMachine& machine, JB::IlVa
 ///
 
 inline void halt(Model::CBuilder* b, VirtMachine& machine) {
-	b->Call("print_s", 1, b->Const((void*)"$$$ machine halt\n"));
+	assert(!machine.native()); // a halt escapes, so a native body never has one.
+	Trace::message(b, "$$$ machine halt\n");
 	machine.commit(b);
 	b->Return();
 }
 
+/// Return from a called function. See the runtime ret(). The frame is gone, so only the
+/// stack is written back: the buffered locals die with it, and the pc is the caller's.
+/// A native body has no frame record, and returns the result in a register. An inlined
+/// callee leaves its result on top, for the Inliner to pop its frame.
+inline void ret(Model::CBuilder* b, VirtMachine& machine) {
+	KSlotInt value = machine.stack.pop(b);
+	if (machine.inlineDepth() != 0) {
+		machine.stack.push(b, value);
+		return;
+	}
+
+	if (machine.native()) {
+		Trace::message(b, "$$$ machine return native\n");
+		b->Return(value.toIl(b));
+		return;
+	}
+
+	JB::IlValue* record = machine.frames.record(b);
+	JB::IlBuilder* caller = nullptr;
+	JB::IlBuilder* host = nullptr;
+	b->IfThenElse(&caller, &host, b->NotEqualTo(record, b->ConstAddress(nullptr)));
+
+	// Entered from the host: stop, as the runtime ret() does. First, as the caller's reset()
+	// drops the buffered slots.
+	machine.stack.push(host, value);
+	machine.commit(host);
+
+	machine.frames.pop(caller, record);
+	machine.stack.reset(caller, record);
+	machine.stack.push(caller, value);
+	machine.stack.commit(caller);
+
+	Trace::message(b, "$$$ machine return\n");
+	b->Return();
+}
+
 /// relative fallthrough.
 inline void next(Model::CBuilder* b, VirtMachine& machine, CSize offset) {
 	std::intptr_t off = offset.unpack();
 	std::size_t index = machine.instruction.index(b).unpack();
 	std::size_t target = index + off;
 
-	b->Call("print_s", 1, b->Const((void*)"$$$ machine next: offset="));
-	b->Call("print_u", 1, offset.toIl(b));
-	b->Call("print_s", 1, b->Const((void*)" target-index="));
-	b->Call("print_u", 1, b->Const((std::int64_t)target));
-	b->Call("print_s", 1, b->Const((void*)"\n"));
+	Trace::staticValue(b, "$$$ machine next: offset=", off);
+	Trace::staticValue(b, "$$$ machine next: target-index=", target);
 
+	if (machine.control.isLeader(target)) {
+		machine.materializeKnown(b);
+	}
 	machine.control.next(b, target);
 }
 
-/// Relative conditional if, signed offset.
-inline void ifCmpNotEqualZero(Model::CBuilder* b, VirtMachine& machine, JB::IlValue* cond, CInt64 offset) {
+/// Relative conditional if, signed offset. A known condition is decided now: if it is
+/// true, the branch becomes a goto, and returns false, since control never falls through.
+/// Either way, the successor that cannot be reached gets no edge, so unless something
+/// else reaches it, it is never built.
+inline bool ifCmpNotEqualZero(Model::CBuilder* b, VirtMachine& machine, KSlotInt cond, CInt64 offset) {
 
 	std::intptr_t off = offset.unpack();
 	std::size_t index = machine.instruction.index(b).unpack();
@@ -469,16 +993,105 @@ inline void ifCmpNotEqualZero(Model::CBuilder* b, VirtMachine& machine, JB::IlVa
 	std::size_t target = index + off;
 	std::uint8_t* targetpc = pc + off;
 
-	b->Call("print_s", 1, b->Const((void*)"$$$ machine ifCmpNotEqualZero offset="));
-	b->Call("print_u", 1, b->Const((std::int64_t)off));
-	b->Call("print_s", 1, b->Const((void*)" target-pc="));
-	b->Call("print_u", 1, b->Const((std::int64_t)targetpc));
-	b->Call("print_s", 1, b->Const((void*)" target-index="));
-	b->Call("print_u", 1, b->Const((std::int64_t)target));
-	b->Call("print_s", 1, b->Const((void* )"\n"));
+	Trace::staticValue(b, "$$$ machine ifCmpNotEqualZero offset=", off);
+	Trace::staticValue(b, "$$$ machine ifCmpNotEqualZero target-pc=", std::uintptr_t(targetpc));
+	Trace::staticValue(b, "$$$ machine ifCmpNotEqualZero target-index=", target);
+
+	if (cond.isKnown()) {
+		Trace::staticValue(b, "$$$ machine ifCmpNotEqualZero known-cond=", cond.value());
+		if (cond.value() == 0) {
+			return true;
+		}
+		machine.materializeKnown(b);
+		machine.control.Goto(b, target);
+		return false;
+	}
 
 	// _pcReg.store(b, CPtr<std::uint8_t>::pack(targetPc));
-	machine.control.IfCmpNotEqualZero(b, cond, target);
+	machine.materializeKnown(b);
+	machine.control.IfCmpNotEqualZero(b, cond.unpack(), target);
+	return true;
+}
+
+/// Call callee. See the runtime call(). A small enough callee is inlined, with no frame at all.
+/// Otherwise the arguments and the frame record are written to the stack, and the callee is
+/// called: directly, if it already has a compiled body, see call_compiled(). If not, it is
+/// run, see call_body(), which also counts it, and tiers it up.
+inline void call(Model::CBuilder* b, VirtMachine& machine, CPtr<::Func> callee, CSize size) {
+	::Func* function = callee.unpack();
+
+	if (Inliner::inlinable(function, machine.inlineDepth())) {
+		Inliner::inline_call(b, machine, function);
+	} else {
+		assert(machine.inlineDepth() == 0); // everything an inlined callee calls is inlined.
+		JB::IlValue* interpreter = machine.frames.interpreter();
+
+		machine.instruction.commit(b); // the frame record saves the pc.
+		JB::IlValue* record = machine.stack.insert(b,
+			CSize::pack(function->nparams), CSize::pack(FrameChain::RECORD_SLOTS));
+		machine.frames.push(b, record);
+
+		Trace::staticValue(b, "$$$ machine call: callee=", std::uintptr_t(function));
+		CompiledFn body = function->installedBody();
+		if (body != nullptr) {
+			call_compiled(b, interpreter, b->ConstAddress(reinterpret_cast<void*>(body)));
+		} else {
+			call_body(b, interpreter, b->ConstAddress(function));
+		}
+
+		// The callee's RETURN left the result where the record was.
+		machine.stack.returned(b);
+	}
+
+	next(b, machine, size);
+}
+
+///
+/// Abstract control flow operations, for the PURE model. They generate nothing, and record
+/// the edges out of the current block. Known conditions are decided just as the compiler
+/// decides them, so both reach the same blocks.
+///
+
+/// The host reads the VM's memory after a halt, so the frame escapes.
+inline void halt(OMR_UNUSED JB::IlBuilder* b, PureMachine& machine) {
+	machine.control.escape();
+}
+
+inline void ret(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED PureMachine& machine) {}
+
+/// relative fallthrough.
+inline void next(JB::IlBuilder* b, PureMachine& machine, PSize offset) {
+	machine.control.next(b, machine.instruction.index(b).unpack() + offset.unpack());
+}
+
+/// Relative conditional if, signed offset. See the compile-time ifCmpNotEqualZero().
+inline bool ifCmpNotEqualZero(JB::IlBuilder* b, PureMachine& machine, PSlotInt cond, PInt64 offset) {
+	std::size_t target = machine.instruction.index(b).unpack() + offset.unpack();
+
+	if (cond.isKnown()) {
+		if (cond.unpack() == 0) {
+			return true;
+		}
+		machine.control.Goto(b, target);
+		return false;
+	}
+
+	machine.control.IfCmpNotEqualZero(b, target);
+	return true;
+}
+
+/// The callee takes its arguments, and leaves a result that is not known. The caller's
+/// locals are out of the callee's reach, but unless the callee is inlined, the frame
+/// escapes: the call writes it to the stack, and the callee's frame is built above it.
+inline void call(JB::IlBuilder* b, PureMachine& machine, PPtr<::Func> callee, PSize size) {
+	if (!Inliner::inlinable(callee.unpack())) {
+		machine.control.escape();
+	}
+	for (std::size_t i = 0; i < callee.unpack()->nparams; ++i) {
+		machine.stack.pop(b);
+	}
+	machine.stack.push(b, PSlotInt());
+	next(b, machine, size);
 }
 
 }  // namespace Model
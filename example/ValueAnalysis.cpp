@@ -0,0 +1,99 @@
+#include <ValueAnalysis.hpp>
+#include <BytecodeHandlers.hpp>
+#include <BytecodeMethodBuilder.hpp>
+#include <Interpreter.hpp>
+
+#include <BytecodeHandlerTable.hpp>
+
+namespace {
+
+constexpr Model::Mode M = Model::Mode::PURE;
+
+template <Op OP, typename HandlerT>
+using Case = JB::BytecodeHandlerCase<std::uint32_t(OP), HandlerT>;
+
+using PureHandlerTable = JB::StaticBytecodeHandlerTable<Model::PureMachine, GenDefault<M>,
+	Case<Op::UNKNOWN,    GenError<M>>,
+	Case<Op::NOP,        GenNop<M>>,
+	Case<Op::HALT,       GenHalt<M>>,
+	Case<Op::PUSH_CONST, GenPushConst<M>>,
+	Case<Op::ADD,        GenAdd<M>>,
+	Case<Op::PUSH_LOCAL, GenPushLocal<M>>,
+	Case<Op::POP_LOCAL,  GenPopLocal<M>>,
+	Case<Op::BRANCH_IF,  GenBranchIf<M>>,
+	Case<Op::CALL,       GenCall<M>>,
+	Case<Op::RETURN,     GenReturn<M>>
+>;
+
+}  // namespace
+
+ValueAnalysis::ValueAnalysis(const Func* func, JB::BytecodeBuilderTable* builders)
+	: _func(func)
+	, _data(Model::PPtr<std::uint8_t>::pack(const_cast<std::uint8_t*>(func->body)), builders)
+	, _entries()
+	, _escapes(false) {}
+
+void ValueAnalysis::run(JB::IlBuilder* scratch) {
+	JB::BytecodeBuilderTable* builders = _data.builders();
+
+	_entries.clear();
+	_entries.resize(builders->blockCount());
+	_escapes = false;
+
+	// On entry, nothing is known about the locals, parameters included, and the stack is empty.
+	std::unique_ptr<Model::PureMachine> initial(new Model::PureMachine(_data));
+	initial->instruction.initialize(_func, _data);
+	initial->stack.initialize();
+	initial->locals.initialize(_func->nlocals);
+	_entries[0] = std::move(initial);
+
+	std::vector<std::size_t> worklist = {0};
+	std::vector<bool> queued(builders->blockCount(), false);
+	queued[0] = true;
+
+	PureHandlerTable handlers;
+
+	while (!worklist.empty()) {
+		std::size_t block = worklist.back();
+		worklist.pop_back();
+		queued[block] = false;
+
+		Model::PureMachine machine(*_entries[block]);
+
+		// The same walk as the compile: one block, bytecode after bytecode.
+		std::size_t index = builders->leader(block);
+		while (true) {
+			builders->setCursor(index);
+			handlers.invoke(scratch, machine, std::uint32_t(_func->body[index]));
+
+			JB::BytecodeInfo info = decode_instruction(_func, index);
+			std::size_t next = index + info.length;
+			if (info.branches || !info.fallsThrough || builders->isLeader(next)) {
+				break;
+			}
+			index = next;
+		}
+
+		_escapes = _escapes || machine.control.escapes();
+
+		for (std::size_t target : machine.control.successors()) {
+			std::size_t id = builders->blockId(target);
+			std::unique_ptr<Model::PureMachine>& entry = _entries[id];
+			bool changed = true;
+			if (entry == nullptr) {
+				entry.reset(new Model::PureMachine(machine));
+				entry->control.clearSuccessors();
+			} else {
+				changed = entry->join(machine);
+			}
+			if (changed && !queued[id]) {
+				queued[id] = true;
+				worklist.push_back(id);
+			}
+		}
+	}
+}
+
+const Model::PureMachine* ValueAnalysis::entry(std::size_t index) const {
+	return _entries.at(_data.builders()->blockId(index)).get();
+}
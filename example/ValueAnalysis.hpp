@@ -0,0 +1,44 @@
+#if !defined(VALUEANALYSIS_HPP_)
+#define VALUEANALYSIS_HPP_
+
+#include <Model.hpp>
+#include <OMR/Model/FunctionData.hpp>
+
+#include <BytecodeBuilderTable.hpp>
+#include <IlBuilder.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+struct Func;
+
+/// Abstract interpretation of a function's blocks, in the PURE model.
+///
+/// The bytecode handlers are run over each block with a PureMachine, which tracks the
+/// values known at compile time and the stack depth, until the state on entry to every
+/// block stops changing. A value is known on entry to a block only if every path into
+/// the block leaves the same value there. The blocks must already be numbered.
+class ValueAnalysis {
+public:
+	ValueAnalysis(const Func* func, OMR::JitBuilder::BytecodeBuilderTable* builders);
+
+	/// Run the handlers to a fixed point. Anything they generate goes into scratch, which
+	/// must never be appended to a method.
+	void run(OMR::JitBuilder::IlBuilder* scratch);
+
+	/// The state on entry to the block starting at index, or nullptr if no path reaches it.
+	const Model::PureMachine* entry(std::size_t index) const;
+
+	/// True if anything outside the function can see its locals or operands, on some path:
+	/// the function halts, or makes a call that is not inlined. See PureControlFlow.
+	bool escapes() const { return _escapes; }
+
+private:
+	const Func* _func;
+	OMR::Model::FunctionData<Model::Mode::PURE> _data;
+	std::vector<std::unique_ptr<Model::PureMachine>> _entries; //< block id -> entry state.
+	bool _escapes;
+};
+
+#endif // VALUEANALYSIS_HPP_
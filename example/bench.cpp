@@ -0,0 +1,142 @@
+#include <Interpreter.hpp>
+#include <CompileQueue.hpp>
+
+#include <OMR/ByteBuffer.hpp>
+#include <JitBuilder.hpp>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/// Count local[0] down from n to zero. One iteration is six bytecodes,
+/// ending in a taken backwards BRANCH_IF.
+std::unique_ptr<Func> countdown(std::int64_t n) {
+	OMR::ByteBuffer buffer;
+	buffer << Func(1, 0);
+	buffer << Op::PUSH_CONST << std::int64_t(n);        // 00 + 1 + 8
+	buffer << Op::POP_LOCAL  << std::int64_t(0);        // 09 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 18 + 1 + 8 <- loop
+	buffer << Op::PUSH_CONST << std::int64_t(-1);       // 27 + 1 + 8
+	buffer << Op::ADD;                                  // 36 + 1
+	buffer << Op::POP_LOCAL  << std::int64_t(0);        // 37 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 46 + 1 + 8
+	buffer << Op::BRANCH_IF  << std::int64_t(18 - 55 - 9); // 55 + 1 + 8
+	buffer << Op::HALT;                                 // 64 + 1
+	return std::unique_ptr<Func>(reinterpret_cast<Func*>(buffer.release()));
+}
+
+enum class BenchMode { SWITCH, THREADED, JIT, TIERUP };
+
+const char* to_string(BenchMode mode) {
+	switch (mode) {
+	case BenchMode::SWITCH:
+		return "switch";
+	case BenchMode::THREADED:
+		return "threaded";
+	case BenchMode::JIT:
+		return "jit";
+	case BenchMode::TIERUP:
+		return "tierup";
+	default:
+		return "xxx";
+	}
+}
+
+/// If cacheTop is clear, the interpreted modes keep every operand in stack memory.
+void bench(BenchMode mode, std::int64_t n, bool cacheTop = true) {
+	InterpreterOptions options;
+	options.cacheTop = cacheTop;
+	if (mode == BenchMode::THREADED) {
+		options.dispatch = Dispatch::THREADED;
+	}
+
+	Interpreter interpreter(options);
+	std::unique_ptr<Func> func = countdown(n);
+
+	if (mode == BenchMode::JIT) {
+		interpreter.compile(func.get());
+	}
+
+	if (mode == BenchMode::TIERUP) {
+		// The first call is already hot: the timed run includes the compile.
+		interpreter.setJitThreshold(1);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	interpreter.run(func.get());
+	auto end = std::chrono::steady_clock::now();
+
+	std::chrono::duration<double, std::nano> elapsed = end - start;
+
+	std::printf("%-10s %-6s iterations=%-12" PRId64 " total=%10.3fms per-iteration=%8.3fns\n",
+		to_string(mode), cacheTop ? "tos" : "memory", n, elapsed.count() / 1e6, elapsed.count() / double(n));
+}
+
+/// Compile count fresh functions with CompileQueue::compileAll on the given number of
+/// workers, and return the elapsed milliseconds.
+double bench_batch(std::size_t count, std::size_t workers) {
+	std::vector<std::unique_ptr<Func>> funcs;
+	std::vector<Func*> batch;
+	for (std::size_t i = 0; i < count; ++i) {
+		funcs.push_back(countdown(std::int64_t(i)));
+		batch.push_back(funcs.back().get());
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	CompileQueue::Stats stats = CompileQueue::compileAll(batch, workers);
+	auto end = std::chrono::steady_clock::now();
+
+	std::chrono::duration<double, std::milli> elapsed = end - start;
+
+	std::printf("batch      functions=%-6zu workers=%-3zu total=%10.3fms per-function=%8.3fms max-latency=%10.3fms",
+		stats.installed, workers, elapsed.count(), elapsed.count() / double(count),
+		std::chrono::duration<double, std::milli>(stats.maxLatency).count());
+	return elapsed.count();
+}
+
+/// Compile batches on 1, 2, 4... workers, up to the number of cores, and print each speedup
+/// over one worker. JitBuilder compiles are serialized, so this shows how far the work
+/// around them, which the workers do overlap, can carry the speedup.
+void bench_batch_scaling(std::size_t count) {
+	std::size_t cores = std::thread::hardware_concurrency();
+	if (cores == 0) {
+		cores = 1;
+	}
+
+	double serial = bench_batch(count, 1);
+	std::printf(" speedup=%5.2fx\n", 1.0);
+	for (std::size_t workers = 2; workers <= cores; workers *= 2) {
+		double elapsed = bench_batch(count, workers);
+		std::printf(" speedup=%5.2fx\n", serial / elapsed);
+	}
+}
+
+/// usage: example-bench [iterations] [batch-functions]
+extern "C" int main(int argc, char** argv) {
+	std::int64_t n = 10000000;
+	if (argc > 1) {
+		n = std::strtoll(argv[1], nullptr, 10);
+	}
+
+	std::size_t count = 256;
+	if (argc > 2) {
+		count = std::strtoull(argv[2], nullptr, 10);
+	}
+
+	initializeJit();
+	bench(BenchMode::SWITCH, n, false);
+	bench(BenchMode::SWITCH, n);
+	bench(BenchMode::THREADED, n, false);
+	bench(BenchMode::THREADED, n);
+	bench(BenchMode::JIT, n);
+	bench(BenchMode::TIERUP, n);
+
+	bench_batch_scaling(count);
+	shutdownJit();
+	return 0;
+}
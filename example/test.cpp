@@ -1,10 +1,20 @@
 #include <Interpreter.hpp>
+#include <CompileQueue.hpp>
+#include <FrameAnalysis.hpp>
+#include <Inliner.hpp>
+#include <JitHelpers.hpp>
 
 #include <OMR/ByteBuffer.hpp>
+#include <OMR/Model/OperandArray.hpp>
+#include <OMR/Model/OperandStack.hpp>
+#include <OMR/Model/SlotType.hpp>
 #include <cstdint>
+#include <cstring>
 #include <inttypes.h>
 #include <gtest/gtest.h>
 #include <memory>
+#include <thread>
+#include <vector>
 #include <JitBuilder.hpp>
 
 template <typename T>
@@ -21,12 +31,14 @@ inline std::unique_ptr<Func> release_func(OMR::ByteBuffer& buffer) {
 	return release_to_unique<Func>(buffer);
 }
 
-enum class RunMode { INT, JIT };
+enum class RunMode { INT, THREADED, JIT };
 
 std::string to_string(RunMode mode) {
 	switch (mode) {
 	case RunMode::INT:
 		return std::string("int");
+	case RunMode::THREADED:
+		return std::string("threaded");
 	case RunMode::JIT:
 		return std::string("jit");
 	default:
@@ -44,6 +56,14 @@ protected:
 
 	virtual void TearDown() override {}
 
+	InterpreterOptions options() const {
+		InterpreterOptions options;
+		if (GetParam() == RunMode::THREADED) {
+			options.dispatch = Dispatch::THREADED;
+		}
+		return options;
+	}
+
 	void print_debug(Interpreter& interpreter, Func* target) {
 		fprintf(stderr, "int main: interpreter=%p\n", &interpreter);
 		fprintf(stderr, "int main: target=%p\n", target);
@@ -54,9 +74,9 @@ protected:
 
 	void run_jit(Interpreter& interpreter, Func* target) {
 		print_debug(interpreter, target);
-		ASSERT_EQ(target->cbody, nullptr);
+		ASSERT_EQ(target->installedBody(), nullptr);
 		interpreter.compile(target);
-		ASSERT_NE(target->cbody, nullptr);
+		ASSERT_NE(target->installedBody(), nullptr);
 		interpreter.run_cbody(target);
 	}
 
@@ -71,6 +91,7 @@ protected:
 			run_jit(interpreter, target);
 			break;
 		case RunMode::INT:
+		case RunMode::THREADED:
 			run_int(interpreter, target);
 			break;
 		default:
@@ -79,7 +100,7 @@ protected:
 	}
 
 	void run(Func* func) {
-		Interpreter interpreter;
+		Interpreter interpreter(options());
 		run(interpreter, func);
 	}
 };
@@ -118,11 +139,26 @@ TEST_P(RunTest, PushContThenHalt) {
 	buffer << Op::PUSH_CONST << std::int64_t(42);
 	buffer << Op::HALT;
 
-	Interpreter interp;
+	Interpreter interp(options());
 	run(interp, release_func(buffer).get());
 	EXPECT_EQ(interp.peek(), 42);
 }
 
+TEST_P(RunTest, HaltWritesBackRegisters) {
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(42);
+	buffer << Op::PUSH_CONST << std::int64_t(43);
+	buffer << Op::ADD;
+	buffer << Op::HALT;
+
+	Interpreter interp(options());
+	run(interp, release_func(buffer).get());
+	const SlotInt* sp = reinterpret_cast<const SlotInt*>(interp.sp());
+	EXPECT_EQ(interp.peek(0), 85);
+	EXPECT_EQ(sp[-1], 85); // the sp in memory is one slot above the result.
+}
+
 TEST_P(RunTest, PushTwoConsts) {
 	OMR::ByteBuffer buffer;
 	buffer << Func();
@@ -130,7 +166,7 @@ TEST_P(RunTest, PushTwoConsts) {
 	buffer << Op::PUSH_CONST << std::int64_t(444);
 	buffer << Op::HALT;
 
-	Interpreter interp;
+	Interpreter interp(options());
 	run(interp, release_func(buffer).get());
 	EXPECT_EQ(interp.peek(0), 333);
 	EXPECT_EQ(interp.peek(1), 444);
@@ -144,7 +180,7 @@ TEST_P(RunTest, PushThreeConsts) {
 	buffer << Op::PUSH_CONST << std::int64_t(555);
 	buffer << Op::HALT;
 
-	Interpreter interp;
+	Interpreter interp(options());
 	run(interp, release_func(buffer).get());
 	EXPECT_EQ(interp.peek(0), 333);
 	EXPECT_EQ(interp.peek(1), 444);
@@ -159,7 +195,7 @@ TEST_P(RunTest, AddTwoConsts) {
 	buffer << Op::ADD;
 	buffer << Op::HALT;
 
-	Interpreter interp;
+	Interpreter interp(options());
 	run(interp, release_func(buffer).get());
 	EXPECT_EQ(interp.peek(), 777);
 }
@@ -174,7 +210,7 @@ TEST_P(RunTest, AddThreeConsts) {
 	buffer << Op::ADD;
 	buffer << Op::HALT;
 
-	Interpreter interp;
+	Interpreter interp(options());
 	run(interp, release_func(buffer).get());
 	EXPECT_EQ(interp.peek(), 999);
 }
@@ -188,7 +224,7 @@ TEST_P(RunTest, PopLocalThenPushLocal) {
 	buffer << Op::PUSH_LOCAL << std::int64_t(0);
 	buffer << Op::HALT;
 
-	Interpreter interp;
+	Interpreter interp(options());
 	run(interp, release_func(buffer).get());
 	EXPECT_EQ(interp.peek(0), 123); // local[0]
 	EXPECT_EQ(interp.peek(1), 999); // stack[-1]
@@ -207,7 +243,7 @@ TEST_P(RunTest, BranchIfTrue) {
 	buffer << Op::PUSH_CONST << std::int64_t(8);        // 30 + 1 + 8
 	buffer << Op::HALT;                                 // 39 + 1
 
-	Interpreter interp;
+	Interpreter interp(options());
 	run(interp, release_func(buffer).get());
 	EXPECT_EQ(interp.peek(0), 8);
 }
@@ -224,15 +260,929 @@ TEST_P(RunTest, BranchIfFalse) {
 	buffer << Op::PUSH_CONST << std::int64_t(8);        // 30 + 1 + 8
 	buffer << Op::HALT;                                 // 39 + 1
 
-	Interpreter interp;
+	Interpreter interp(options());
 	run(interp, release_func(buffer).get());
 	EXPECT_EQ(interp.peek(0), 7);
 }
 
+TEST_P(RunTest, BranchIfOnFoldedCondition) {
+	OMR::ByteBuffer buffer;
+	buffer << Func(1, 0);
+	buffer << Op::PUSH_CONST << std::int64_t(5);        // 00 + 1 + 8
+	buffer << Op::POP_LOCAL  << std::int64_t(0);        // 09 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 18 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(-5);       // 27 + 1 + 8
+	buffer << Op::ADD;                                  // 36 + 1
+	buffer << Op::BRANCH_IF  << std::int64_t(10);       // 37 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(7);        // 46 + 1 + 8
+	buffer << Op::HALT;                                 // 55 + 1
+	buffer << Op::PUSH_CONST << std::int64_t(8);        // 56 + 1 + 8
+	buffer << Op::HALT;                                 // 65 + 1
+
+	Interpreter interp(options());
+	run(interp, release_func(buffer).get());
+	EXPECT_EQ(interp.peek(0), 5); // local[0]
+	EXPECT_EQ(interp.peek(1), 7);
+}
+
+TEST_P(RunTest, ConfigurationLocalKnownAcrossLoop) {
+	OMR::ByteBuffer buffer;
+	buffer << Func(3, 0);
+	buffer << Op::PUSH_CONST << std::int64_t(3);        // 00 + 1 + 8
+	buffer << Op::POP_LOCAL  << std::int64_t(0);        // 09 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(4);        // 18 + 1 + 8
+	buffer << Op::POP_LOCAL  << std::int64_t(1);        // 27 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(0);        // 36 + 1 + 8
+	buffer << Op::POP_LOCAL  << std::int64_t(2);        // 45 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(2);        // 54 + 1 + 8 <- loop
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 63 + 1 + 8
+	buffer << Op::ADD;                                  // 72 + 1
+	buffer << Op::POP_LOCAL  << std::int64_t(2);        // 73 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(1);        // 82 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(-1);       // 91 + 1 + 8
+	buffer << Op::ADD;                                  // 100 + 1
+	buffer << Op::POP_LOCAL  << std::int64_t(1);        // 101 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(1);        // 110 + 1 + 8
+	buffer << Op::BRANCH_IF  << std::int64_t(54 - 119 - 9); // 119 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 128 + 1 + 8
+	buffer << Op::BRANCH_IF  << std::int64_t(10);       // 137 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(7);        // 146 + 1 + 8
+	buffer << Op::HALT;                                 // 155 + 1
+	buffer << Op::PUSH_CONST << std::int64_t(8);        // 156 + 1 + 8
+	buffer << Op::HALT;                                 // 165 + 1
+
+	Interpreter interp(options());
+	run(interp, release_func(buffer).get());
+	EXPECT_EQ(interp.peek(0), 3);  // local[0], known in every block.
+	EXPECT_EQ(interp.peek(1), 0);  // local[1]
+	EXPECT_EQ(interp.peek(2), 12); // local[2]
+	EXPECT_EQ(interp.peek(3), 8);
+}
+
+TEST_P(RunTest, CountDownLoop) {
+	OMR::ByteBuffer buffer;
+	buffer << Func(2, 0);
+	buffer << Op::PUSH_CONST << std::int64_t(5);        // 00 + 1 + 8
+	buffer << Op::POP_LOCAL  << std::int64_t(0);        // 09 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(0);        // 18 + 1 + 8
+	buffer << Op::POP_LOCAL  << std::int64_t(1);        // 27 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(1);        // 36 + 1 + 8 <- loop
+	buffer << Op::PUSH_CONST << std::int64_t(2);        // 45 + 1 + 8
+	buffer << Op::ADD;                                  // 54 + 1
+	buffer << Op::POP_LOCAL  << std::int64_t(1);        // 55 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 64 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(-1);       // 73 + 1 + 8
+	buffer << Op::ADD;                                  // 82 + 1
+	buffer << Op::POP_LOCAL  << std::int64_t(0);        // 83 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 92 + 1 + 8
+	buffer << Op::BRANCH_IF  << std::int64_t(36 - 101 - 9); // 101 + 1 + 8
+	buffer << Op::HALT;                                 // 110 + 1
+
+	std::unique_ptr<Func> func = release_func(buffer);
+
+	Interpreter interp(options());
+	run(interp, func.get());
+	EXPECT_EQ(interp.peek(0), 0);  // local[0]
+	EXPECT_EQ(interp.peek(1), 10); // local[1]
+	EXPECT_EQ(func->backedges, 0u); // tier-up is off, so nothing counts.
+}
+
+TEST_P(RunTest, TopOfStackCacheMatchesMemoryStack) {
+	OMR::ByteBuffer buffer;
+	buffer << Func(1, 0);
+	buffer << Op::PUSH_CONST << std::int64_t(3);        // 00 + 1 + 8
+	buffer << Op::POP_LOCAL  << std::int64_t(0);        // 09 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 18 + 1 + 8 <- loop
+	buffer << Op::PUSH_CONST << std::int64_t(-1);       // 27 + 1 + 8
+	buffer << Op::ADD;                                  // 36 + 1
+	buffer << Op::POP_LOCAL  << std::int64_t(0);        // 37 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 46 + 1 + 8
+	buffer << Op::BRANCH_IF  << std::int64_t(18 - 55 - 9); // 55 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(5);        // 64 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(6);        // 73 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(7);        // 82 + 1 + 8
+	buffer << Op::ADD;                                  // 91 + 1
+	buffer << Op::HALT;                                 // 92 + 1
+	std::unique_ptr<Func> func = release_func(buffer);
+
+	for (bool cacheTop : {false, true}) {
+		InterpreterOptions opts = options();
+		opts.cacheTop = cacheTop;
+
+		Interpreter interp(opts);
+		run(interp, func.get());
+		const SlotInt* sp = reinterpret_cast<const SlotInt*>(interp.sp());
+		EXPECT_EQ(interp.peek(0), 0);  // local[0]
+		EXPECT_EQ(interp.peek(1), 5);
+		EXPECT_EQ(interp.peek(2), 13);
+		EXPECT_EQ(sp[-1], 13); // the whole stack is in memory after HALT.
+	}
+}
+
+TEST_P(RunTest, TierUpOnBackEdges) {
+	if (GetParam() == RunMode::JIT) {
+		GTEST_SKIP() << "only the generated interpreter counts calls and back-edges";
+	}
+
+	OMR::ByteBuffer buffer;
+	buffer << Func(1, 0);
+	buffer << Op::PUSH_CONST << std::int64_t(5);        // 00 + 1 + 8
+	buffer << Op::POP_LOCAL  << std::int64_t(0);        // 09 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 18 + 1 + 8 <- loop
+	buffer << Op::PUSH_CONST << std::int64_t(-1);       // 27 + 1 + 8
+	buffer << Op::ADD;                                  // 36 + 1
+	buffer << Op::POP_LOCAL  << std::int64_t(0);        // 37 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 46 + 1 + 8
+	buffer << Op::BRANCH_IF  << std::int64_t(18 - 55 - 9); // 55 + 1 + 8
+	buffer << Op::HALT;                                 // 64 + 1
+	std::unique_ptr<Func> func = release_func(buffer);
+
+	InterpreterOptions opts = options();
+	opts.jitThreshold = 3;
+
+	// One call and four taken back-edges: hot, but only compiled on the next call.
+	Interpreter first(opts);
+	first.run(func.get());
+	EXPECT_EQ(func->invocations, 1u);
+	EXPECT_EQ(func->backedges, 4u);
+	EXPECT_EQ(func->installedBody(), nullptr);
+	EXPECT_EQ(first.peek(0), 0);
+
+	Interpreter second(opts);
+	second.run(func.get());
+	EXPECT_NE(func->installedBody(), nullptr);
+	EXPECT_EQ(second.peek(0), 0);
+}
+
+TEST(RuntimeTest, CompileRecordsArenaStats) {
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(1);
+	buffer << Op::HALT;
+	std::unique_ptr<Func> func = release_func(buffer);
+
+	Interpreter interp;
+	OMR::Arena::Stats before = Runtime::get().arenaStats();
+	interp.compile(func.get());
+	OMR::Arena::Stats after = Runtime::get().arenaStats();
+	EXPECT_GT(after.allocations, before.allocations);
+	EXPECT_GE(after.reserved, after.bytes);
+}
+
+TEST(RuntimeTest, BackgroundTierUp) {
+	OMR::ByteBuffer buffer;
+	buffer << Func(1, 0);
+	buffer << Op::PUSH_CONST << std::int64_t(7);
+	buffer << Op::POP_LOCAL  << std::int64_t(0);
+	buffer << Op::HALT;
+	std::unique_ptr<Func> func = release_func(buffer);
+
+	CompileQueue queue;
+	InterpreterOptions opts;
+	opts.jitThreshold = 1;
+	opts.compileQueue = &queue;
+
+	// The first call queues the compile, and carries on interpreting.
+	Interpreter first(opts);
+	first.run(func.get());
+	EXPECT_EQ(first.peek(0), 7);
+
+	queue.drain();
+	EXPECT_NE(func->installedBody(), nullptr);
+	EXPECT_TRUE(func->queued.load());
+	EXPECT_FALSE(queue.enqueue(func.get()));
+
+	// The flag is on the function, so another queue does not compile it again.
+	CompileQueue other;
+	EXPECT_FALSE(other.enqueue(func.get()));
+
+	CompileQueue::Stats stats = queue.stats();
+	EXPECT_EQ(stats.enqueued, 1u);
+	EXPECT_EQ(stats.installed, 1u);
+	EXPECT_EQ(stats.depth, 0u);
+
+	Interpreter second(opts);
+	second.run(func.get());
+	EXPECT_EQ(second.peek(0), 7);
+}
+
+TEST(RuntimeTest, CompileAll) {
+	std::vector<std::unique_ptr<Func>> funcs;
+	std::vector<Func*> batch;
+	for (std::int64_t i = 0; i < 4; ++i) {
+		OMR::ByteBuffer buffer;
+		buffer << Func();
+		buffer << Op::PUSH_CONST << i;
+		buffer << Op::HALT;
+		funcs.push_back(release_func(buffer));
+		batch.push_back(funcs.back().get());
+	}
+	batch.push_back(batch.front()); // duplicates are compiled once.
+
+	CompileQueue::Stats stats = CompileQueue::compileAll(batch, 2);
+	EXPECT_EQ(stats.installed, 4u);
+	EXPECT_EQ(stats.deduplicated, 1u);
+
+	for (std::int64_t i = 0; i < 4; ++i) {
+		ASSERT_NE(funcs[i]->installedBody(), nullptr);
+		Interpreter interp;
+		interp.run(funcs[i].get());
+		EXPECT_EQ(interp.peek(), i);
+	}
+}
+
+TEST(RuntimeTest, InterpretersOnManyThreads) {
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(1);
+	buffer << Op::PUSH_CONST << std::int64_t(2);
+	buffer << Op::ADD;
+	buffer << Op::HALT;
+	std::unique_ptr<Func> func = release_func(buffer);
+
+	// Interpreters may be created on any thread. They all share one runtime: its generated
+	// interpreter first, then the compiled body.
+	for (bool compiled : {false, true}) {
+		if (compiled) {
+			Interpreter().compile(func.get());
+		}
+
+		std::int64_t results[4] = {};
+		std::vector<std::thread> threads;
+		for (std::int64_t& result : results) {
+			threads.emplace_back([&func, &result] {
+				Interpreter interp;
+				interp.run(func.get());
+				result = interp.peek();
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		for (std::int64_t result : results) {
+			EXPECT_EQ(result, 3);
+		}
+	}
+}
+
+TEST(RuntimeTest, InterpreterReusesPooledStack) {
+	{
+		Interpreter first;
+	}
+	// The first interpreter gave its stack back, so the second does not map a new one.
+	OMR::StackSegmentPool::Stats before = Runtime::get().stacks().stats();
+	Interpreter second;
+	OMR::StackSegmentPool::Stats after = Runtime::get().stacks().stats();
+	EXPECT_EQ(after.reused, before.reused + 1);
+	EXPECT_EQ(after.mapped, before.mapped);
+}
+
+TEST_P(RunTest, StackOverflowIsAnError) {
+	if (GetParam() == RunMode::JIT) {
+		GTEST_SKIP() << "the stack depth at a compiled loop header must be fixed";
+	}
+
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(1);       // 00 + 1 + 8 <- loop
+	buffer << Op::PUSH_CONST << std::int64_t(1);       // 09 + 1 + 8
+	buffer << Op::BRANCH_IF  << std::int64_t(0 - 18 - 9); // 18 + 1 + 8
+	buffer << Op::HALT;
+	std::unique_ptr<Func> func = release_func(buffer);
+
+	InterpreterOptions opts = options();
+	opts.stackSize = 4096;
+
+	// Each iteration leaves one more value on the stack, until it runs into the guard page.
+	Interpreter interp(opts);
+	EXPECT_EQ(interp.run(func.get()), Status::STACK_OVERFLOW);
+
+	// The interpreter is still usable afterwards.
+	OMR::ByteBuffer ok;
+	ok << Func();
+	ok << Op::PUSH_CONST << std::int64_t(3);
+	ok << Op::HALT;
+	EXPECT_EQ(interp.run(release_func(ok).get()), Status::OK);
+	EXPECT_EQ(interp.peek(), 3);
+}
+
+TEST_P(RunTest, SegmentedStackFitsLargeFrame) {
+	// More locals than fit in one pooled segment.
+	std::size_t nlocals = 2 * OMR::StackSegmentPool::DEFAULT_SEGMENT_SIZE / OMR::Model::SLOT_SIZE;
+
+	OMR::ByteBuffer buffer;
+	buffer << Func(nlocals, 0);
+	buffer << Op::PUSH_CONST << std::int64_t(9);
+	buffer << Op::POP_LOCAL  << std::int64_t(nlocals - 1);
+	buffer << Op::PUSH_LOCAL << std::int64_t(nlocals - 1);
+	buffer << Op::HALT;
+	std::unique_ptr<Func> func = release_func(buffer);
+
+	InterpreterOptions opts = options();
+	opts.segmentedStack = true;
+
+	Interpreter interp(opts);
+	run(interp, func.get());
+	EXPECT_EQ(interp.peek(nlocals - 1), 9);
+	EXPECT_EQ(interp.peek(nlocals), 9);
+}
+
+/// add(a, b). The parameters are the callee's first locals.
+inline std::unique_ptr<Func> make_add() {
+	OMR::ByteBuffer buffer;
+	buffer << Func(2, 2);
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);
+	buffer << Op::PUSH_LOCAL << std::int64_t(1);
+	buffer << Op::ADD;
+	buffer << Op::RETURN;
+	return release_func(buffer);
+}
+
+/// Push 5, call add(40, 2), push 7.
+inline std::unique_ptr<Func> make_call_add(Func* add) {
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(5);
+	buffer << Op::PUSH_CONST << std::int64_t(40);
+	buffer << Op::PUSH_CONST << std::int64_t(2);
+	buffer << Op::CALL << add;
+	buffer << Op::PUSH_CONST << std::int64_t(7);
+	buffer << Op::HALT;
+	return release_func(buffer);
+}
+
+TEST_P(RunTest, CallReturnsInPlaceOfArguments) {
+	std::unique_ptr<Func> add = make_add();
+	std::unique_ptr<Func> caller = make_call_add(add.get());
+
+	Interpreter interp(options());
+	run(interp, caller.get());
+	EXPECT_EQ(interp.peek(0), 5);
+	EXPECT_EQ(interp.peek(1), 42);
+	EXPECT_EQ(interp.peek(2), 7);
+}
+
+TEST_P(RunTest, CallCompiledCallee) {
+	std::unique_ptr<Func> add = make_add();
+	std::unique_ptr<Func> caller = make_call_add(add.get());
+
+	Interpreter interp(options());
+	interp.compile(add.get());
+	ASSERT_NE(add->installedBody(), nullptr);
+	run(interp, caller.get());
+	EXPECT_EQ(interp.peek(0), 5);
+	EXPECT_EQ(interp.peek(1), 42);
+	EXPECT_EQ(interp.peek(2), 7);
+}
+
+TEST_P(RunTest, CallInlinedIntoCompiledCaller) {
+	// add3(a, b, c) = add(add(a, b), c). Small and straight-line, as add is.
+	std::unique_ptr<Func> add = make_add();
+	OMR::ByteBuffer callee;
+	callee << Func(3, 3);
+	callee << Op::PUSH_LOCAL << std::int64_t(0);
+	callee << Op::PUSH_LOCAL << std::int64_t(1);
+	callee << Op::CALL << add.get();
+	callee << Op::PUSH_LOCAL << std::int64_t(2);
+	callee << Op::CALL << add.get();
+	callee << Op::RETURN;
+	std::unique_ptr<Func> add3 = release_func(callee);
+	EXPECT_TRUE(Inliner::inlinable(add3.get()));
+
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(5);
+	buffer << Op::PUSH_CONST << std::int64_t(40);
+	buffer << Op::PUSH_CONST << std::int64_t(1);
+	buffer << Op::PUSH_CONST << std::int64_t(1);
+	buffer << Op::CALL << add3.get();
+	buffer << Op::PUSH_CONST << std::int64_t(7);
+	buffer << Op::HALT;
+	std::unique_ptr<Func> caller = release_func(buffer);
+
+	Interpreter interp(options());
+	run(interp, caller.get());
+	EXPECT_EQ(interp.peek(0), 5);
+	EXPECT_EQ(interp.peek(1), 42);
+	EXPECT_EQ(interp.peek(2), 7);
+
+	// Compiled, both calls are inlined, so neither callee is ever run.
+	std::size_t runs = GetParam() == RunMode::JIT ? 0 : 1;
+	EXPECT_EQ(add3->invocations, runs);
+	EXPECT_EQ(add->invocations, 2 * runs);
+}
+
+/// inc(x), padded past the inlining budget.
+inline std::unique_ptr<Func> make_large_inc() {
+	OMR::ByteBuffer buffer;
+	buffer << Func(1, 1);
+	for (std::size_t i = 0; i < Inliner::MAX_BYTES; ++i) {
+		buffer << Op::NOP;
+	}
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);
+	buffer << Op::PUSH_CONST << std::int64_t(1);
+	buffer << Op::ADD;
+	buffer << Op::RETURN;
+	return release_func(buffer);
+}
+
+TEST_P(RunTest, CallTooLargeToInline) {
+	std::unique_ptr<Func> inc = make_large_inc();
+	EXPECT_FALSE(Inliner::inlinable(inc.get()));
+
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(41);
+	buffer << Op::CALL << inc.get();
+	buffer << Op::HALT;
+	std::unique_ptr<Func> caller = release_func(buffer);
+
+	// The callee is interpreted.
+	Interpreter interp(options());
+	run(interp, caller.get());
+	EXPECT_EQ(interp.peek(0), 42);
+
+	// Then compiled. A compiled caller finds its body when the call runs.
+	interp.compile(inc.get());
+	Interpreter again(options());
+	EXPECT_EQ(again.run(caller.get()), Status::OK);
+	EXPECT_EQ(again.peek(0), 42);
+}
+
+TEST(RuntimeTest, CompiledCallerCallsCompiledCallee) {
+	std::unique_ptr<Func> inc = make_large_inc();
+
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(41);
+	buffer << Op::CALL << inc.get();
+	buffer << Op::HALT;
+	std::unique_ptr<Func> caller = release_func(buffer);
+
+	// The callee's body exists when the caller is compiled, so the call goes straight to it,
+	// and the callee is never counted.
+	Interpreter interp;
+	interp.compile(inc.get());
+	interp.compile(caller.get());
+	EXPECT_EQ(interp.run_cbody(caller.get()), Status::OK);
+	EXPECT_EQ(interp.peek(0), 42);
+	EXPECT_EQ(inc->invocations, 0u);
+}
+
+TEST_P(RunTest, SegmentedStackCallCrossesSegments) {
+	// add(a, b), with more locals than fit in one pooled segment, so its frame is on a new
+	// one, and padded past the inlining budget, so it is called.
+	std::size_t nlocals = 2 * OMR::StackSegmentPool::DEFAULT_SEGMENT_SIZE / OMR::Model::SLOT_SIZE;
+	OMR::ByteBuffer callee;
+	callee << Func(nlocals, 2);
+	for (std::size_t i = 0; i < Inliner::MAX_BYTES; ++i) {
+		callee << Op::NOP;
+	}
+	callee << Op::PUSH_LOCAL << std::int64_t(0);
+	callee << Op::PUSH_LOCAL << std::int64_t(1);
+	callee << Op::ADD;
+	callee << Op::POP_LOCAL  << std::int64_t(nlocals - 1);
+	callee << Op::PUSH_LOCAL << std::int64_t(nlocals - 1);
+	callee << Op::RETURN;
+	std::unique_ptr<Func> add = release_func(callee);
+	std::unique_ptr<Func> caller = make_call_add(add.get());
+
+	InterpreterOptions opts = options();
+	opts.segmentedStack = true;
+
+	// The arguments move to the new segment, and the result comes back.
+	Interpreter interp(opts);
+	run(interp, caller.get());
+	EXPECT_EQ(interp.peek(0), 5);
+	EXPECT_EQ(interp.peek(1), 42);
+	EXPECT_EQ(interp.peek(2), 7);
+}
+
+TEST_P(RunTest, CalleeTiersUp) {
+	if (GetParam() == RunMode::JIT) {
+		GTEST_SKIP() << "only the generated interpreter counts calls";
+	}
+
+	std::unique_ptr<Func> inc = make_large_inc();
+
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(41);
+	buffer << Op::CALL << inc.get();
+	buffer << Op::HALT;
+	std::unique_ptr<Func> caller = release_func(buffer);
+
+	// Calls are counted, as runs from the host are, so the callee gets hot.
+	InterpreterOptions opts = options();
+	opts.jitThreshold = 2;
+	for (std::size_t i = 0; i < 2; ++i) {
+		Interpreter interp(opts);
+		EXPECT_EQ(interp.run(caller.get()), Status::OK);
+		EXPECT_EQ(interp.peek(0), 42);
+	}
+	EXPECT_NE(inc->installedBody(), nullptr);
+}
+
+TEST_P(RunTest, ReturnWithNoCallerHalts) {
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(40);
+	buffer << Op::PUSH_CONST << std::int64_t(2);
+	buffer << Op::ADD;
+	buffer << Op::RETURN;
+	std::unique_ptr<Func> func = release_func(buffer);
+
+	// Entered from the host, the result is left on the stack. Compiled, the function gets
+	// a native body, so the host enters its adapter.
+	Interpreter interp(options());
+	run(interp, func.get());
+	EXPECT_EQ(interp.peek(0), 42);
+	if (GetParam() == RunMode::JIT) {
+		EXPECT_NE(func->installedNativeBody(), nullptr);
+	}
+}
+
+TEST_P(RunTest, DeepRecursionIsAnError) {
+	// f() calls itself forever. On a segmented stack, its frames never run out of room: each
+	// full segment nests one more run, so only the nesting bound stops it, before the native
+	// stack overflows.
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::CALL << static_cast<Func*>(nullptr);
+	buffer << Op::HALT;
+	std::unique_ptr<Func> func = release_func(buffer);
+	Func* self = func.get();
+	std::memcpy(&func->body[1], &self, sizeof(self));
+
+	InterpreterOptions opts = options();
+	opts.segmentedStack = true;
+
+	Interpreter interp(opts);
+	if (GetParam() == RunMode::JIT) {
+		interp.compile(func.get());
+	}
+	EXPECT_EQ(interp.run(func.get()), Status::STACK_OVERFLOW);
+
+	// The interpreter is reset, and runs again.
+	std::unique_ptr<Func> add = make_add();
+	std::unique_ptr<Func> caller = make_call_add(add.get());
+	EXPECT_EQ(interp.run(caller.get()), Status::OK);
+	EXPECT_EQ(interp.peek(1), 42);
+}
+
+TEST_P(RunTest, InterpretedCallsDoNotNest) {
+	if (GetParam() == RunMode::JIT) {
+		GTEST_SKIP() << "a compiled function's calls nest on the native stack";
+	}
+
+	// sum(n) = n == 0 ? 0 : sum(n - 1) + n, far deeper than the nesting bound. Each CALL runs
+	// the callee in the same loop, and each RETURN resumes the caller, with its own locals.
+	OMR::ByteBuffer buffer;
+	buffer << Func(1, 1);
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 00 + 1 + 8
+	buffer << Op::BRANCH_IF  << std::int64_t(10);       // 09 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(0);        // 18 + 1 + 8
+	buffer << Op::RETURN;                               // 27 + 1
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 28 + 1 + 8
+	buffer << Op::PUSH_CONST << std::int64_t(-1);       // 37 + 1 + 8
+	buffer << Op::ADD;                                  // 46 + 1
+	buffer << Op::CALL << static_cast<Func*>(nullptr);  // 47 + 1 + 8
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);        // 56 + 1 + 8
+	buffer << Op::ADD;                                  // 65 + 1
+	buffer << Op::RETURN;                               // 66 + 1
+	std::unique_ptr<Func> sum = release_func(buffer);
+	Func* self = sum.get();
+	std::memcpy(&sum->body[48], &self, sizeof(self));
+
+	InterpreterOptions opts = options();
+	opts.maxCallDepth = 4;
+
+	Interpreter interp(opts);
+	std::int64_t result = 0;
+	EXPECT_EQ(interp.call(sum.get(), result, std::int64_t(100)), Status::OK);
+	EXPECT_EQ(result, 5050);
+	EXPECT_EQ(sum->invocations, 101u);
+}
+
+TEST_P(RunTest, CallFramelessCallee) {
+	// sum(n) = n + (n - 1) + ... + 1. It neither halts nor calls, so its frame never
+	// escapes: compiled, its locals live in IL values, across its loop.
+	OMR::ByteBuffer callee;
+	callee << Func(2, 1);
+	callee << Op::PUSH_CONST << std::int64_t(0);        // 00 + 1 + 8
+	callee << Op::POP_LOCAL  << std::int64_t(1);        // 09 + 1 + 8
+	callee << Op::PUSH_LOCAL << std::int64_t(1);        // 18 + 1 + 8 <- loop
+	callee << Op::PUSH_LOCAL << std::int64_t(0);        // 27 + 1 + 8
+	callee << Op::ADD;                                  // 36 + 1
+	callee << Op::POP_LOCAL  << std::int64_t(1);        // 37 + 1 + 8
+	callee << Op::PUSH_LOCAL << std::int64_t(0);        // 46 + 1 + 8
+	callee << Op::PUSH_CONST << std::int64_t(-1);       // 55 + 1 + 8
+	callee << Op::ADD;                                  // 64 + 1
+	callee << Op::POP_LOCAL  << std::int64_t(0);        // 65 + 1 + 8
+	callee << Op::PUSH_LOCAL << std::int64_t(0);        // 74 + 1 + 8
+	callee << Op::BRANCH_IF  << std::int64_t(18 - 83 - 9); // 83 + 1 + 8
+	callee << Op::PUSH_LOCAL << std::int64_t(1);        // 92 + 1 + 8
+	callee << Op::RETURN;                               // 101 + 1
+	std::unique_ptr<Func> sum = release_func(callee);
+	EXPECT_FALSE(Inliner::inlinable(sum.get()));
+
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(5);
+	buffer << Op::PUSH_CONST << std::int64_t(4);
+	buffer << Op::CALL << sum.get();
+	buffer << Op::PUSH_CONST << std::int64_t(7);
+	buffer << Op::HALT;
+	std::unique_ptr<Func> caller = release_func(buffer);
+
+	Interpreter interp(options());
+	interp.compile(sum.get());
+	ASSERT_NE(sum->installedBody(), nullptr);
+	EXPECT_TRUE(sum->frameless);
+	run(interp, caller.get());
+	EXPECT_EQ(interp.peek(0), 5);
+	EXPECT_EQ(interp.peek(1), 10);
+	EXPECT_EQ(interp.peek(2), 7);
+}
+
+TEST_P(RunTest, FramelessLoopAtEntry) {
+	// sum(n, acc) loops back to index 0, so the entry state is merged into. Local 2 is no
+	// parameter: it starts out as 0, and is written on every trip.
+	OMR::ByteBuffer callee;
+	callee << Func(3, 2);
+	callee << Op::PUSH_LOCAL << std::int64_t(1);        // 00 + 1 + 8 <- loop
+	callee << Op::PUSH_LOCAL << std::int64_t(0);        // 09 + 1 + 8
+	callee << Op::ADD;                                  // 18 + 1
+	callee << Op::POP_LOCAL  << std::int64_t(1);        // 19 + 1 + 8
+	callee << Op::PUSH_LOCAL << std::int64_t(0);        // 28 + 1 + 8
+	callee << Op::PUSH_CONST << std::int64_t(-1);       // 37 + 1 + 8
+	callee << Op::ADD;                                  // 46 + 1
+	callee << Op::POP_LOCAL  << std::int64_t(2);        // 47 + 1 + 8
+	callee << Op::PUSH_LOCAL << std::int64_t(2);        // 56 + 1 + 8
+	callee << Op::POP_LOCAL  << std::int64_t(0);        // 65 + 1 + 8
+	callee << Op::PUSH_LOCAL << std::int64_t(0);        // 74 + 1 + 8
+	callee << Op::BRANCH_IF  << std::int64_t(0 - 83 - 9); // 83 + 1 + 8
+	callee << Op::PUSH_LOCAL << std::int64_t(1);        // 92 + 1 + 8
+	callee << Op::RETURN;                               // 101 + 1
+	std::unique_ptr<Func> sum = release_func(callee);
+
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(4);
+	buffer << Op::PUSH_CONST << std::int64_t(0);
+	buffer << Op::CALL << sum.get();
+	buffer << Op::HALT;
+	std::unique_ptr<Func> caller = release_func(buffer);
+
+	Interpreter interp(options());
+	interp.compile(sum.get());
+	ASSERT_NE(sum->installedBody(), nullptr);
+	EXPECT_TRUE(sum->frameless);
+	run(interp, caller.get());
+	EXPECT_EQ(interp.peek(0), 10);
+}
+
+TEST_P(RunTest, CallNativeBody) {
+	// add(a, b) = a + b never halts or calls, so it gets a native body.
+	OMR::ByteBuffer callee;
+	callee << Func(2, 2);
+	callee << Op::PUSH_LOCAL << std::int64_t(0);
+	callee << Op::PUSH_LOCAL << std::int64_t(1);
+	callee << Op::ADD;
+	callee << Op::RETURN;
+	std::unique_ptr<Func> add = release_func(callee);
+
+	Interpreter interp(options());
+	interp.compile(add.get());
+	ASSERT_NE(add->installedNativeBody(), nullptr);
+
+	// From the host: in registers, with the operand stack untouched.
+	const std::uint8_t* sp = interp.sp();
+	std::int64_t result = 0;
+	EXPECT_EQ(interp.call(add.get(), result, 40, 2), Status::OK);
+	EXPECT_EQ(result, 42);
+	EXPECT_EQ(interp.call(add.get(), result, -1, 1), Status::OK);
+	EXPECT_EQ(result, 0);
+	EXPECT_EQ(interp.sp(), sp);
+
+	// From bytecode: through the adapter, unless the caller is compiled and inlines it.
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(40);
+	buffer << Op::PUSH_CONST << std::int64_t(2);
+	buffer << Op::CALL << add.get();
+	buffer << Op::HALT;
+	std::unique_ptr<Func> caller = release_func(buffer);
+
+	run(interp, caller.get());
+	EXPECT_EQ(interp.peek(0), 42);
+
+	// A function that halts gets no native body.
+	OMR::ByteBuffer halts;
+	halts << Func();
+	halts << Op::HALT;
+	std::unique_ptr<Func> host = release_func(halts);
+	interp.compile(host.get());
+	EXPECT_NE(host->installedBody(), nullptr);
+	EXPECT_EQ(host->installedNativeBody(), nullptr);
+}
+
+TEST_P(RunTest, CallWithoutNativeBody) {
+	// inc2(x) = inc(inc(x)). Its calls are not inlined, so its frame escapes, and it never
+	// gets a native body: call() runs it on the operand stack.
+	std::unique_ptr<Func> inc = make_large_inc();
+	OMR::ByteBuffer buffer;
+	buffer << Func(1, 1);
+	buffer << Op::PUSH_LOCAL << std::int64_t(0);
+	buffer << Op::CALL << inc.get();
+	buffer << Op::CALL << inc.get();
+	buffer << Op::RETURN;
+	std::unique_ptr<Func> inc2 = release_func(buffer);
+	EXPECT_TRUE(frame_escapes(inc2.get()));
+
+	Interpreter interp(options());
+	if (GetParam() == RunMode::JIT) {
+		interp.compile(inc2.get());
+		ASSERT_NE(inc2->installedBody(), nullptr);
+		EXPECT_EQ(inc2->installedNativeBody(), nullptr);
+		EXPECT_FALSE(inc2->frameless);
+	}
+
+	const std::uint8_t* sp = interp.sp();
+	std::int64_t result = 0;
+	EXPECT_EQ(interp.call(inc2.get(), result, 40), Status::OK);
+	EXPECT_EQ(result, 42);
+	EXPECT_EQ(interp.sp(), sp);
+}
+
+#if OMR_MODEL_CHECKED
+TEST_P(RunTest, CheckedPoisonsDeadSlots) {
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(1);
+	buffer << Op::PUSH_CONST << std::int64_t(2);
+	buffer << Op::ADD;
+	buffer << Op::HALT;
+
+	// A cached top of stack never reaches memory, so there would be no slot to poison.
+	InterpreterOptions opts = options();
+	opts.cacheTop = false;
+
+	Interpreter interp(opts);
+	run(interp, release_func(buffer).get());
+	EXPECT_EQ(interp.peek(0), 3);
+
+	if (GetParam() == RunMode::JIT) {
+		// Compiled code keeps the operands in registers, so the slot was never written.
+		SlotInt fill;
+		std::memset(&fill, OMR::Model::CheckedChecks::POISON_BYTE, sizeof(fill));
+		EXPECT_EQ(interp.peek(1), fill);
+	} else {
+		EXPECT_EQ(interp.peek(1), OMR::Model::CheckedChecks::POISON_SLOT);
+	}
+}
+#endif
+
+#if OMR_MODEL_TRACE == OMR_MODEL_TRACE_RING
+TEST_P(RunTest, RingTraceRecords) {
+	OMR::ByteBuffer buffer;
+	buffer << Func();
+	buffer << Op::PUSH_CONST << std::int64_t(42);
+	buffer << Op::HALT;
+
+	Interpreter interp(options());
+	run(interp, release_func(buffer).get());
+	EXPECT_EQ(interp.peek(), 42);
+
+	// The PUSH_CONST handler records the constant it pushes.
+	const OMR::Model::TraceBuffer& trace = interp.trace();
+	bool found = false;
+	for (std::size_t i = 0; i < trace.size(); ++i) {
+		const OMR::Model::TraceRecord& record = trace.at(i);
+		if (std::strcmp(record.label, "$$$ PUSH_CONST: const-value=") == 0 && record.value == 42) {
+			found = true;
+		}
+	}
+	EXPECT_TRUE(found);
+}
+#endif
+
+/// Builds void(SlotInt** sp, SlotInt* locals), which moves the T in locals[0] to locals[1]
+/// through M's operand stack, with the typed operations. The stack is committed and reloaded
+/// between the pushes and the pop, so the popped value is loaded back as a T. A second copy
+/// is left on the stack.
+template <OMR::Model::Mode M, typename T>
+class TypedSlotsBuilder : public JB::MethodBuilder {
+public:
+	TypedSlotsBuilder(JB::TypeDictionary* t) : JB::MethodBuilder(t) {
+		DefineName("typed-slots");
+		DefineLine("0");
+		DefineFile("<test>");
+		JitHelpers::define(this);
+		DefineParameter("sp_address", t->PointerTo(t->PointerTo(OMR::Model::slotType(t))));
+		DefineParameter("locals", t->PointerTo(OMR::Model::slotType(t)));
+		DefineReturnType(t->NoType);
+	}
+
+	virtual bool buildIL() override {
+		JB::TypeDictionary* t = typeDictionary();
+#if OMR_MODEL_TRACE == OMR_MODEL_TRACE_RING
+		OMR::Model::Trace::initialize(this, ConstAddress(&_trace));
+#endif
+		OMR::Model::OperandStack<M> stack;
+		OMR::Model::OperandArray<M> locals;
+		stack.initialize(this, OMR::Model::slotType(t), Load("sp_address"), &_arena);
+		locals.initialize(this, OMR::Model::slotType(t), Load("locals"), OMR::Model::Size<M>(this, 2), &_arena);
+
+		stack.template push<T>(this, locals.template get<T>(this, OMR::Model::Size<M>(this, 0)));
+		stack.template push<T>(this, locals.template get<T>(this, OMR::Model::Size<M>(this, 0)));
+		stack.commit(this);
+		stack.reload(this);
+		locals.template set<T>(this, OMR::Model::Size<M>(this, 1), stack.template pop<T>(this));
+
+		locals.commit(this);
+		stack.commit(this);
+		Return();
+		return true;
+	}
+
+private:
+	OMR::Arena _arena;
+#if OMR_MODEL_TRACE == OMR_MODEL_TRACE_RING
+	OMR::Model::TraceBuffer _trace;
+#endif
+};
+
+/// Check that value survives the typed operations of M's operand stack and array, bit for bit.
+template <OMR::Model::Mode M, typename T>
+void check_typed_slots(T value) {
+	BytecodeMethodCompiler compiler;
+	TypedSlotsBuilder<M, T> builder(compiler.typedict());
+	void* entry = nullptr;
+	ASSERT_EQ(compileMethodBuilder(&builder, &entry), 0);
+
+	SlotInt stack[4] = {};
+	SlotInt locals[2] = {};
+	std::memcpy(&locals[0], &value, sizeof(T));
+	SlotInt* sp = stack;
+	reinterpret_cast<void (*)(SlotInt**, SlotInt*)>(entry)(&sp, locals);
+
+	T moved;
+	std::memcpy(&moved, &locals[1], sizeof(T));
+	EXPECT_EQ(moved, value);
+
+	T left;
+	std::memcpy(&left, &stack[0], sizeof(T));
+	EXPECT_EQ(left, value);
+	EXPECT_EQ(sp, stack + 1);
+}
+
+TEST(ModelTest, RealTypedSlots) {
+	using OMR::Model::Mode;
+	check_typed_slots<Mode::REAL, std::int32_t>(-7);
+	check_typed_slots<Mode::REAL, float>(1.5f);
+#if OMR_MODEL_SLOT_SIZE == 8
+	check_typed_slots<Mode::REAL, std::int64_t>(std::int64_t(1) << 40);
+	check_typed_slots<Mode::REAL, double>(-2.25);
+	static int anchor;
+	check_typed_slots<Mode::REAL, void*>(&anchor);
+#endif
+}
+
+TEST(ModelTest, VirtTypedSlots) {
+	using OMR::Model::Mode;
+	check_typed_slots<Mode::VIRT, std::int32_t>(-7);
+	check_typed_slots<Mode::VIRT, float>(1.5f);
+#if OMR_MODEL_SLOT_SIZE == 8
+	check_typed_slots<Mode::VIRT, std::int64_t>(std::int64_t(1) << 40);
+	check_typed_slots<Mode::VIRT, double>(-2.25);
+	static int anchor;
+	check_typed_slots<Mode::VIRT, void*>(&anchor);
+#endif
+}
+
+TEST(ModelTest, PureTypedSlotsAreUnknown) {
+	OMR::Model::PureOperandStack stack;
+	stack.initialize();
+	stack.push<float>(nullptr, OMR::Model::PValue<float>::pack(1.5f));
+	stack.push(nullptr, OMR::Model::PSlotInt::pack(3));
+	EXPECT_EQ(stack.pop<SlotInt>(nullptr), OMR::Model::PSlotInt::pack(3));
+	EXPECT_FALSE(stack.pop<float>(nullptr).isKnown());
+	EXPECT_EQ(stack.depth(), 0u);
+
+	OMR::Model::PureOperandArray locals;
+	locals.initialize(2);
+	locals.set(nullptr, OMR::Model::PSize::pack(0), OMR::Model::PSlotInt::pack(5));
+	locals.set<float>(nullptr, OMR::Model::PSize::pack(1), OMR::Model::PValue<float>::pack(5.0f));
+	EXPECT_EQ(locals.get<SlotInt>(nullptr, OMR::Model::PSize::pack(0)), OMR::Model::PSlotInt::pack(5));
+	EXPECT_FALSE(locals.get(nullptr, OMR::Model::PSize::pack(1)).isKnown());
+}
+
 INSTANTIATE_TEST_SUITE_P(
 	IntAndJit,
 	RunTest,
-	::testing::Values(RunMode::INT, RunMode::JIT),
+	::testing::Values(RunMode::INT, RunMode::THREADED, RunMode::JIT),
 	runmode_param_to_string
 );
 
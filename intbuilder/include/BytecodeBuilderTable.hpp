@@ -4,33 +4,79 @@
 #include <MethodBuilder.hpp>
 #include <BytecodeBuilder.hpp>
 
-#include <map>
-#include <cstdio>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
 namespace OMR {
 namespace JitBuilder {
 
+/// The bytecode builders of a method, one per basic block.
+/// Leaders, the first bytecodes of each block, are found by a pre-pass and numbered densely
+/// in bytecode order. Only leaders have builders. The bytecodes following a leader, up to
+/// the next leader, are emitted into the leader's builder.
 class BytecodeBuilderTable {
 public:
-	using Map = std::map<std::size_t, CBuilder*>;
-	using Iter = Map::iterator;
-	using Node = std::pair<const std::size_t, CBuilder*>;
+	static constexpr std::int32_t NOT_A_LEADER = -1;
 
+	BytecodeBuilderTable() : _blockIds(), _leaders(), _builders(), _cursor(0) {}
+
+	/// Mark the bytecode at index as the start of a basic block.
+	void addLeader(std::size_t index) {
+		assert(_builders.empty()); // blocks are already numbered.
+		if (index >= _blockIds.size()) {
+			_blockIds.resize(index + 1, NOT_A_LEADER);
+		}
+		_blockIds[index] = 0;
+	}
+
+	/// Assign each leader a dense block id, in bytecode order. Call once, after all leaders are added.
+	void numberBlocks() {
+		assert(_builders.empty());
+		for (std::size_t index = 0; index < _blockIds.size(); ++index) {
+			if (_blockIds[index] != NOT_A_LEADER) {
+				_blockIds[index] = std::int32_t(_leaders.size());
+				_leaders.push_back(index);
+			}
+		}
+		_builders.resize(_leaders.size(), nullptr);
+	}
+
+	bool isLeader(std::size_t index) const {
+		return index < _blockIds.size() && _blockIds[index] != NOT_A_LEADER;
+	}
+
+	std::size_t blockCount() const { return _leaders.size(); }
+
+	std::size_t blockId(std::size_t index) const {
+		assert(isLeader(index));
+		return std::size_t(_blockIds[index]);
+	}
+
+	/// The bytecode index of block's first bytecode.
+	std::size_t leader(std::size_t block) const { return _leaders.at(block); }
+
+	/// The builder for the block starting at index. Created on first use.
 	CBuilder* get(IlBuilder* b, std::size_t index) {
-		std::pair<Iter, bool> search = _map.insert(Node(index, nullptr));
-		Iter iter = search.first;
-		bool found = search.second;
-		if (found) {
-			assert(iter->second == nullptr);
-			iter->second = b->OrphanCBuilder(index, (char*)"unknown-bytecode");
-			fprintf(stderr, "@@@ BytecodeBuilderTable: creating bytecode builder index=%lu\n", index);
+		CBuilder*& builder = _builders[blockId(index)];
+		if (builder == nullptr) {
+			builder = b->OrphanCBuilder(index, (char*)"unknown-bytecode");
 		}
-		assert(iter->second != nullptr);
-		return iter->second;
+		return builder;
 	}
 
+	/// The index of the bytecode being compiled. A block's builder is shared by all of its
+	/// bytecodes, so the builder's bcIndex is only the index of the first.
+	std::size_t cursor() const { return _cursor; }
+
+	void setCursor(std::size_t index) { _cursor = index; }
+
 private:
-	Map _map;
+	std::vector<std::int32_t> _blockIds; //< bytecode index -> block id, or NOT_A_LEADER.
+	std::vector<std::size_t> _leaders;   //< block id -> bytecode index.
+	std::vector<CBuilder*> _builders;    //< block id -> builder.
+	std::size_t _cursor;
 };
 
 }  // namespace JitBuilder
@@ -5,9 +5,14 @@
 #include <BytecodeBuilderTable.hpp>
 #include <MethodBuilder.hpp>
 
+#include <OMR/Model.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
-#include <map>
 #include <memory>
+#include <vector>
 
 namespace OMR {
 namespace JitBuilder {
@@ -29,7 +34,6 @@ public:
 	virtual bool invoke(CBuilder* b) override final {
 		VmStateT* state = static_cast<VmStateT*>(b->vmState());
 		assert(state != nullptr);
-		fprintf(stderr, "@@@ invoking bc-builder=%p vm-state=%p\n", b, state);
 		return _handler(b, *state);
 	}
 
@@ -37,44 +41,57 @@ private:
 	HandlerT _handler;
 };
 
+/// A dense table of handlers, indexed by opcode.
 class BytecodeHandlerTableBase {
 public:
 	~BytecodeHandlerTableBase() = default;
 
 	bool invoke(CBuilder* b, std::uint32_t opcode) {
-		bool success = false;
-		if (_handlers.count(opcode) != 0) {
-			success = _handlers[opcode]->invoke(b);
-		} else if (_default != nullptr) {
-			success = _default->invoke(b);
-		} else {
-			success = false;
+		BytecodeHandlerEntry* handler = get(opcode);
+		if (handler == nullptr) {
+			handler = _default.get();
+		}
+		if (handler == nullptr) {
+			return false;
 		}
-		return success;
+		return handler->invoke(b);
 	}
 
+	/// The handler for opcode, or nullptr if there is none.
+	BytecodeHandlerEntry* get(std::uint32_t opcode) const {
+		if (opcode < _handlers.size()) {
+			return _handlers[opcode].get();
+		}
+		return nullptr;
+	}
+
+	BytecodeHandlerEntry* getDefault() const { return _default.get(); }
+
+	/// The number of opcodes in the table.
+	std::size_t size() const { return _handlers.size(); }
+
 protected:
-	BytecodeHandlerTableBase() = default;
+	explicit BytecodeHandlerTableBase(std::size_t size) : _handlers(size), _default() {}
 
-	std::map<std::uint32_t, std::unique_ptr<BytecodeHandlerEntry>> _handlers;
+	std::vector<std::unique_ptr<BytecodeHandlerEntry>> _handlers;
 	std::unique_ptr<BytecodeHandlerEntry> _default;
 };
 
-template <typename VmStateT>
+/// A dynamic handler table for an instruction set of N opcodes.
+template <typename VmStateT, std::size_t N>
 class BytecodeHandlerTable final : public BytecodeHandlerTableBase {
 public:
-	BytecodeHandlerTable() = default;
+	BytecodeHandlerTable() : BytecodeHandlerTableBase(N) {}
 
 	template <typename HandlerT>
 	void set(std::uint32_t opcode, const HandlerT& handler) {
-		fprintf(stderr, "create handler bc=%x handler=%p\n", opcode, &handler);
-		assert(_handlers.count(opcode) == 0); // do not allow double inserts.
+		assert(opcode < N);
+		assert(_handlers[opcode] == nullptr); // do not allow double inserts.
 		_handlers[opcode] = wrap(handler);
 	}
 
 	template <typename HandlerT>
 	void setDefault(const HandlerT& handler) {
-		fprintf(stderr, "create default handler handler=%p\n", &handler);
 		assert(_default == nullptr); // do not allow to reset the default handler.
 		_default = wrap(handler);
 	}
@@ -87,6 +104,62 @@ private:
 	}
 };
 
+/// @group Static handler tables.
+/// The handler set is a compile-time list of cases, so the opcode dispatch and the
+/// handler calls inline into the caller. Handlers must be default constructible.
+/// @{
+
+/// Handle OPCODE with a HandlerT.
+template <std::uint32_t OPCODE, typename HandlerT>
+struct BytecodeHandlerCase {
+	static constexpr std::uint32_t opcode = OPCODE;
+	using Handler = HandlerT;
+};
+
+template <typename VmStateT, typename DefaultT, typename... CasesT>
+struct StaticBytecodeHandlerDispatch;
+
+template <typename VmStateT, typename DefaultT>
+struct StaticBytecodeHandlerDispatch<VmStateT, DefaultT> {
+	template <typename BuilderT>
+	static bool invoke(BuilderT* b, VmStateT& state, OMR_UNUSED std::uint32_t opcode) {
+		return DefaultT()(b, state);
+	}
+};
+
+/// A chain of compares on constants, which the C++ compiler lowers to a jump table.
+template <typename VmStateT, typename DefaultT, typename CaseT, typename... CasesT>
+struct StaticBytecodeHandlerDispatch<VmStateT, DefaultT, CaseT, CasesT...> {
+	template <typename BuilderT>
+	static bool invoke(BuilderT* b, VmStateT& state, std::uint32_t opcode) {
+		if (opcode == CaseT::opcode) {
+			return typename CaseT::Handler()(b, state);
+		}
+		return StaticBytecodeHandlerDispatch<VmStateT, DefaultT, CasesT...>::invoke(b, state, opcode);
+	}
+};
+
+/// A handler table fixed at compile time. DefaultT handles opcodes with no case.
+template <typename VmStateT, typename DefaultT, typename... CasesT>
+class StaticBytecodeHandlerTable {
+public:
+	bool invoke(CBuilder* b, std::uint32_t opcode) {
+		VmStateT* state = static_cast<VmStateT*>(b->vmState());
+		assert(state != nullptr);
+		return StaticBytecodeHandlerDispatch<VmStateT, DefaultT, CasesT...>::invoke(b, *state, opcode);
+	}
+
+	/// Invoke with a state of its own, rather than b's, such as the PURE model's, which
+	/// belongs to no builder.
+	template <typename BuilderT>
+	bool invoke(BuilderT* b, VmStateT& state, std::uint32_t opcode) {
+		return StaticBytecodeHandlerDispatch<VmStateT, DefaultT, CasesT...>::invoke(b, state, opcode);
+	}
+};
+
+/// @}
+///
+
 }  // namespace JitBuilder
 }  // namespace OMR
 
@@ -0,0 +1,164 @@
+#if !defined(OMR_ARENA_HPP_)
+#define OMR_ARENA_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace OMR {
+
+/// A bump allocator. Memory is only freed in bulk, when the arena is released or destroyed.
+/// Destructors of objects created in the arena are never run.
+class Arena {
+public:
+	static constexpr std::size_t DEFAULT_BLOCK_SIZE = 16 * 1024; //< in bytes.
+
+	struct Stats {
+		std::size_t allocations = 0; //< number of allocate() calls.
+		std::size_t bytes = 0;       //< bytes handed out, excluding alignment padding.
+		std::size_t blocks = 0;      //< number of blocks malloc'd.
+		std::size_t reserved = 0;    //< bytes malloc'd.
+
+		Stats& operator+=(const Stats& other) {
+			allocations += other.allocations;
+			bytes += other.bytes;
+			blocks += other.blocks;
+			reserved += other.reserved;
+			return *this;
+		}
+	};
+
+	explicit Arena(std::size_t blockSize = DEFAULT_BLOCK_SIZE)
+		: _head(nullptr), _cursor(nullptr), _limit(nullptr), _blockSize(blockSize), _stats() {}
+
+	Arena(const Arena&) = delete;
+
+	Arena& operator=(const Arena&) = delete;
+
+	~Arena() { release(); }
+
+	void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t)) {
+		assert(align != 0 && (align & (align - 1)) == 0); // power of two.
+
+		char* start = alignUp(_cursor, align);
+		if (_cursor == nullptr || start + size > _limit) {
+			grow(size + align);
+			start = alignUp(_cursor, align);
+		}
+
+		_cursor = start + size;
+		_stats.allocations += 1;
+		_stats.bytes += size;
+		return start;
+	}
+
+	/// Construct a T in the arena.
+	template <typename T, typename... Args>
+	T* create(Args&&... args) {
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	/// Free every block. Everything allocated in the arena is gone.
+	void release() {
+		while (_head != nullptr) {
+			Block* next = _head->next;
+			std::free(_head);
+			_head = next;
+		}
+		_cursor = nullptr;
+		_limit = nullptr;
+	}
+
+	const Stats& stats() const { return _stats; }
+
+private:
+	struct Block {
+		Block* next;
+	};
+
+	static char* alignUp(char* p, std::size_t align) {
+		std::uintptr_t x = reinterpret_cast<std::uintptr_t>(p);
+		return reinterpret_cast<char*>((x + align - 1) & ~(std::uintptr_t(align) - 1));
+	}
+
+	/// Start a new block with room for at least size bytes.
+	void grow(std::size_t size) {
+		std::size_t capacity = size > _blockSize ? size : _blockSize;
+		std::size_t total = sizeof(Block) + capacity;
+
+		Block* block = static_cast<Block*>(std::malloc(total));
+		if (block == nullptr) {
+			throw std::bad_alloc();
+		}
+
+		block->next = _head;
+		_head = block;
+		_cursor = reinterpret_cast<char*>(block + 1);
+		_limit = _cursor + capacity;
+
+		_stats.blocks += 1;
+		_stats.reserved += total;
+	}
+
+	Block* _head;
+	char* _cursor;
+	char* _limit;
+	std::size_t _blockSize;
+	Stats _stats;
+};
+
+/// A standard allocator backed by an Arena. Deallocation is a no-op.
+/// Without an arena, falls back to the global operator new and delete.
+/// The allocator propagates with its container, so an assigned container allocates
+/// from the arena of the container it was assigned from.
+template <typename T>
+class ArenaAllocator {
+public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	ArenaAllocator() : _arena(nullptr) {}
+
+	ArenaAllocator(Arena* arena) : _arena(arena) {}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : _arena(other.arena()) {}
+
+	T* allocate(std::size_t n) {
+		if (_arena == nullptr) {
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+		}
+		return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* p, std::size_t) {
+		if (_arena == nullptr) {
+			::operator delete(p);
+		}
+	}
+
+	Arena* arena() const { return _arena; }
+
+private:
+	Arena* _arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) {
+	return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) {
+	return !(lhs == rhs);
+}
+
+}  // namespace OMR
+
+#endif // OMR_ARENA_HPP_
@@ -1,7 +1,9 @@
 #if !defined(OMR_JITBUILDER_BYTECODEINTERPRETERBUILDER_HPP_)
 #define OMR_JITBUILDER_BYTECODEINTERPRETERBUILDER_HPP_
 
+#include <OMR/Arena.hpp>
 #include <OMR/Model/Builder.hpp>
+#include <OMR/Model/Trace.hpp>
 
 #include <MethodBuilder.hpp>
 #include <VirtualMachineState.hpp>
@@ -10,12 +12,29 @@
 #include <cassert>
 #include <cstdint>
 #include <cstddef>
-#include <map>
+#include <memory>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace OMR {
 namespace JitBuilder {
 
+/// How the generated interpreter dispatches from one bytecode handler to the next.
+enum class Dispatch {
+	SWITCH,   //< One shared switch in a loop.
+	THREADED, //< Each handler's tail decodes and dispatches the next opcode itself.
+};
+
+/// True if HandlerT declares `static constexpr bool TERMINATES = true`: every path through
+/// the handler leaves the interpreter, as a halt or a return does.
+template <typename HandlerT, typename = void>
+struct HandlerTerminates : std::false_type {};
+
+template <typename HandlerT>
+struct HandlerTerminates<HandlerT, decltype(void(HandlerT::TERMINATES))>
+	: std::integral_constant<bool, HandlerT::TERMINATES> {};
+
 class BytecodeInterpreterBuilder : public MethodBuilder {
 public:
 	class Handler {
@@ -23,6 +42,10 @@ public:
 		virtual ~Handler() = default;
 
 		virtual bool invoke(RBuilder* b, VirtualMachineState* state) = 0;
+
+		/// True if the handler never falls through to the next bytecode. Nothing is
+		/// generated after it: no dispatch, and no cache state.
+		virtual bool terminates() const = 0;
 	};
 
 	template <typename HandlerT, typename VmStateT>
@@ -37,49 +60,55 @@ public:
 			return _handler(b, *static_cast<VmStateT*>(state));
 		}
 
+		virtual bool terminates() const override final {
+			return HandlerTerminates<HandlerT>::value;
+		}
+
 	private:
 		HandlerT _handler;
 	};
 
+	/// A dense table of handlers, indexed by opcode.
 	class HandlerTableBase {
 	public:
-		using HandlerMap = std::map<std::uint32_t, std::unique_ptr<Handler>>;
-		
-		HandlerMap* data() { return &_handlers; }
-
-		HandlerMap::iterator begin() { return _handlers.begin(); }
-
-		HandlerMap::iterator end() { return _handlers.end(); }
+		/// The number of opcodes in the table.
+		std::size_t size() const { return _handlers.size(); }
 
 		Handler* getDefault() { return _default.get(); }
 
-		Handler* get(std::uint32_t opcode) { return _handlers[opcode].get(); }
+		/// The handler for opcode, or nullptr if there is none.
+		Handler* get(std::uint32_t opcode) {
+			if (opcode < _handlers.size()) {
+				return _handlers[opcode].get();
+			}
+			return nullptr;
+		}
 
 	protected:
-		HandlerTableBase() = default;
+		explicit HandlerTableBase(std::size_t size) : _handlers(size), _default() {}
 
-		HandlerMap _handlers;
+		std::vector<std::unique_ptr<Handler>> _handlers;
 		std::unique_ptr<Handler> _default;
 
 	private:
 		friend class BytecodeInterpreterBuilder;
 	};
 
-	template <typename VmStateT>
+	/// A handler table for an instruction set of N opcodes.
+	template <typename VmStateT, std::size_t N>
 	class HandlerTable final : public HandlerTableBase {
 	public:
-		HandlerTable() = default;
+		HandlerTable() : HandlerTableBase(N) {}
 
 		template <typename HandlerT>
 		void set(std::uint32_t opcode, const HandlerT& handler) {
-			fprintf(stderr, "create handler bc=%x handler=%p\n", opcode, &handler);
-			assert(_handlers.count(opcode) == 0); // do not allow double inserts.
+			assert(opcode < N);
+			assert(_handlers[opcode] == nullptr); // do not allow double inserts.
 			_handlers[opcode] = wrap(handler);
 		}
 
 		template <typename HandlerT>
 		void setDefault(const HandlerT& handler) {
-			fprintf(stderr, "create default handler handler=%p\n", &handler);
 			assert(_default == nullptr); // do not allow to reset the default handler.
 			_default = wrap(handler);
 		}
@@ -92,38 +121,85 @@ public:
 		}
 	};
 
-	BytecodeInterpreterBuilder(TypeDictionary* t, HandlerTableBase* handlers)
+	/// Opcodes must be below this. In the switch interpreter, a handler's case is its
+	/// opcode plus its cache state times the stride.
+	static constexpr std::int32_t CACHE_STATE_STRIDE = 1 << 16;
+
+	BytecodeInterpreterBuilder(TypeDictionary* t, HandlerTableBase* handlers, Dispatch dispatch = Dispatch::SWITCH)
 		: MethodBuilder(t)
-		, _handlers(handlers) {
+		, _handlers(handlers)
+		, _dispatch(dispatch)
+		, _targets()
+		, _defaultTargets()
+		, _arena() {
 		DefineLocal("interpreter_opcode",   t->Int32);
 		DefineLocal("interpreter_continue", t->Int32);
+		DefineLocal("interpreter_state",    t->Int32);
 	}
 
 	~BytecodeInterpreterBuilder() = default;
 
-	virtual IlValue* getOpcode(IlBuilder* b) = 0;
+	/// Load the next opcode in b. state is the VM state control dispatches from, which may be
+	/// committed, to trace the registers, say: the dispatch goes to the handlers for the cache
+	/// state it is left in.
+	virtual IlValue* getOpcode(IlBuilder* b, VirtualMachineState* state) = 0;
 
-	bool buildInterpreterIL(VirtualMachineState* state) {
+	/// @group Cache states
+	/// A VM state can keep some of the machine in locals between handlers, such as the top of
+	/// the operand stack. Each distinct layout is a cache state, numbered from 0. Every handler
+	/// is generated once per state it can be entered in, and its dispatch goes to the variants
+	/// for the state it exits in. The interpreter is entered in state 0.
+	/// By default there is one state, and handlers are generated once.
+	/// @{
+
+	/// The number of cache states.
+	virtual std::size_t cacheStates() const { return 1; }
+
+	/// Set a fresh copy of the VM state up to be entered in cacheState.
+	virtual void enterCacheState(VirtualMachineState* state, std::size_t cacheState) {}
+
+	/// The cache state state is in, once a handler is done with it. Every path out of a
+	/// handler must leave the same state.
+	virtual std::size_t exitCacheState(VirtualMachineState* state) { return 0; }
+
+	/// @}
+	///
+
+	Dispatch dispatch() const { return _dispatch; }
 
+	/// Memory for this compilation, freed in bulk when the builder is destroyed.
+	/// VM states must allocate their copies (MakeCopy) here: the builder never deletes them.
+	Arena* arena() { return &_arena; }
+
+	bool buildInterpreterIL(VirtualMachineState* state) {
 		assert(state != nullptr);
+		switch (_dispatch) {
+		case Dispatch::THREADED:
+			return buildThreadedInterpreterIL(state);
+		case Dispatch::SWITCH:
+		default:
+			return buildSwitchInterpreterIL(state);
+		}
+	}
 
+private:
+	/// One central switch in a loop. Every handler ends by decoding the next opcode from the
+	/// state it exits in, and jumping back to the loop header. With several cache states, the
+	/// switch is on the opcode and the state together.
+	bool buildSwitchInterpreterIL(VirtualMachineState* state) {
 		Store("interpreter_opcode",   Const(std::int32_t(-1)));
 		Store("interpreter_continue", Const(std::int32_t(1)));
+		Store("interpreter_state",    Const(std::int32_t(0)));
+
+		IlBuilder* entry = OrphanBuilder();
+		AppendBuilder(entry);
+		genDecode(entry, entryState(state));
 
 		IlBuilder* loop = nullptr;
 		IlBuilder* br   = nullptr;
 		IlBuilder* cont = nullptr;
 		DoWhileLoop((char*)"interpreter_continue", &loop, &br, &cont);
 
-		IlBuilder* decode = OrphanBuilder();
-		loop->AppendBuilder(decode);
-		IlValue* opcode = getOpcode(decode);
-		loop->Store("interpreter_opcode", opcode);
-	
-		loop->Call("print_s", 1, loop->Const((void*)"$$$ *** INTERPRETING: opcode="));
-		loop->Call("print_u", 1, loop->Load("interpreter_opcode"));
-		loop->Call("print_s", 1, loop->Const((void*)"\n"));
-
 		IlBuilder* defaultHandler = genDefaultHandler(state);
 		std::vector<IlBuilder::JBCase*> handlers = genHandlers(state);
 
@@ -132,40 +208,181 @@ public:
 		return true;
 	}
 
-private:
-	IlBuilder* genDefaultHandler(VirtualMachineState* state) {
+	/// Every handler ends with its own copy of the decode and dispatch, so each
+	/// indirect branch has a history of its own. There is no loop: the handlers are
+	/// appended one after another, and are only ever entered through a dispatch.
+	/// Without a default handler, an unknown opcode falls out of the interpreter IL.
+	/// A handler's cache state on exit is known when it is generated, so each dispatch
+	/// only switches over the handlers for that state.
+	bool buildThreadedInterpreterIL(VirtualMachineState* state) {
+		Store("interpreter_opcode", Const(std::int32_t(-1)));
+
+		std::size_t states = cacheStates();
+		_targets.resize(states);
+		_defaultTargets.resize(states);
+
+		// Handler builders must exist before any dispatch can jump to them.
+		for (std::size_t s = 0; s < states; ++s) {
+			for (std::uint32_t opcode = 0; opcode < _handlers->size(); ++opcode) {
+				if (_handlers->get(opcode) != nullptr) {
+					_targets[s].push_back(std::make_pair(std::int32_t(opcode), OrphanRBuilder(opcode, (char*)"unnamed")));
+				}
+			}
+		}
 
-		if (_handlers->getDefault() == nullptr) {
-			return nullptr;
+		IlBuilder* exit = OrphanBuilder();
+		std::vector<RBuilder*> defaultHandlers(states, nullptr);
+
+		for (std::size_t s = 0; s < states; ++s) {
+			if (_handlers->getDefault() != nullptr) {
+				defaultHandlers[s] = OrphanRBuilder(-1, (char*)"default");
+				_defaultTargets[s] = defaultHandlers[s];
+			} else {
+				_defaultTargets[s] = exit;
+			}
+		}
+
+		IlBuilder* entry = OrphanBuilder();
+		AppendBuilder(entry);
+		genDispatch(entry, entryState(state));
+
+		for (std::size_t s = 0; s < states; ++s) {
+			for (const auto& target : _targets[s]) {
+				Handler* handler = _handlers->get(target.first);
+				genHandlerBody(target.second, handler, state, s);
+				AppendBuilder(target.second);
+			}
+
+			if (defaultHandlers[s] != nullptr) {
+				genHandlerBody(defaultHandlers[s], _handlers->getDefault(), state, s);
+				AppendBuilder(defaultHandlers[s]);
+			}
+		}
+
+		AppendBuilder(exit);
+		return true;
+	}
+
+	/// A copy of state, as the interpreter is entered: in cache state 0.
+	VirtualMachineState* entryState(VirtualMachineState* state) {
+		VirtualMachineState* copy = state->MakeCopy();
+		enterCacheState(copy, 0);
+		return copy;
+	}
+
+	/// Decode the next opcode in b, from state, and record the case of its handler for the
+	/// cache state state is left in. The switch interpreter's loop dispatches on it.
+	void genDecode(IlBuilder* b, VirtualMachineState* state) {
+		IlValue* opcode = getOpcode(b, state);
+		if (cacheStates() > 1) {
+			std::int32_t cacheState = std::int32_t(exitCacheState(state));
+			opcode = b->Add(opcode, b->Const(cacheState * CACHE_STATE_STRIDE));
+			b->Store("interpreter_state", b->Const(cacheState));
+		}
+		b->Store("interpreter_opcode", opcode);
+		Model::Trace::value(b, "$$$ *** INTERPRETING: opcode=", opcode);
+	}
+
+	/// Decode the next opcode in b, from state, and jump directly to its handler for the
+	/// cache state state is left in.
+	void genDispatch(IlBuilder* b, VirtualMachineState* state) {
+		IlValue* opcode = getOpcode(b, state);
+		std::size_t cacheState = exitCacheState(state);
+		b->Store("interpreter_opcode", opcode);
+		Model::Trace::value(b, "$$$ *** INTERPRETING: opcode=", opcode);
+
+		std::vector<IlBuilder::JBCase*> cases;
+		for (const auto& target : _targets[cacheState]) {
+			IlBuilder* trampoline = b->OrphanBuilder();
+			trampoline->Goto(target.second);
+			cases.push_back(b->MakeCase(target.first, &trampoline, false));
 		}
 
-		RBuilder* b = OrphanRBuilder(-1, (char*)"default");
+		IlBuilder* defaultCase = b->OrphanBuilder();
+		defaultCase->Goto(_defaultTargets[cacheState]);
+
+		b->Switch("interpreter_opcode", &defaultCase, cases.size(), cases.data());
+	}
+
+	/// Generate the handler into b, entered in cacheState, followed by the dispatch to the
+	/// next handler, unless it terminates.
+	void genHandlerBody(RBuilder* b, Handler* handler, VirtualMachineState* state, std::size_t cacheState) {
 		VirtualMachineState* copy = state->MakeCopy();
 		copy->Reload(b);
-		_handlers->getDefault()->invoke(b, copy);
+		enterCacheState(copy, cacheState);
+		handler->invoke(b, copy);
+		if (!handler->terminates()) {
+			genDispatch(b->End(), copy);
+		}
 		b->Finalize();
-		delete copy;
-		return b;
+	}
+
+	/// Generate the handler into b, entered in cacheState, followed by the decode of the next
+	/// opcode, unless it terminates.
+	void genSwitchHandlerBody(RBuilder* b, Handler* handler, VirtualMachineState* state, std::size_t cacheState) {
+		VirtualMachineState* copy = state->MakeCopy();
+		copy->Reload(b);
+		enterCacheState(copy, cacheState);
+		handler->invoke(b, copy);
+		if (!handler->terminates()) {
+			genDecode(b->End(), copy);
+		}
+		b->Finalize();
+	}
+
+	/// The default handler. With several cache states, a switch on the state picks the
+	/// default handler's variant.
+	IlBuilder* genDefaultHandler(VirtualMachineState* state) {
+
+		if (_handlers->getDefault() == nullptr) {
+			return nullptr;
+		}
+
+		std::size_t states = cacheStates();
+		std::vector<IlBuilder*> variants;
+		for (std::size_t s = 0; s < states; ++s) {
+			RBuilder* b = OrphanRBuilder(-1, (char*)"default");
+			genSwitchHandlerBody(b, _handlers->getDefault(), state, s);
+			variants.push_back(b);
+		}
+
+		if (states == 1) {
+			return variants[0];
+		}
+
+		IlBuilder* select = OrphanBuilder();
+		std::vector<IlBuilder::JBCase*> cases;
+		for (std::size_t s = 1; s < states; ++s) {
+			cases.push_back(select->MakeCase(std::int32_t(s), &variants[s], false));
+		}
+		select->Switch("interpreter_state", &variants[0], cases.size(), cases.data());
+		return select;
 	}
 
 	std::vector<IlBuilder::JBCase*> genHandlers(VirtualMachineState* state) {
 		std::vector<IlBuilder::JBCase*> cases;
-		for(const auto& node : *_handlers) {
-			std::int32_t opcode = node.first;
-			RBuilder* b = OrphanRBuilder(opcode, (char*)"unnamed");
-			IlBuilder* bx = b;
-			cases.push_back(MakeCase(opcode, &bx, false));
-			VirtualMachineState* copy = state->MakeCopy();
-			copy->Reload(b);
-			node.second->invoke(b, copy);
-			b->Finalize();
-			delete copy;
+		for (std::size_t s = 0; s < cacheStates(); ++s) {
+			for (std::uint32_t opcode = 0; opcode < _handlers->size(); ++opcode) {
+				Handler* handler = _handlers->get(opcode);
+				if (handler == nullptr) {
+					continue;
+				}
+				assert(opcode < std::uint32_t(CACHE_STATE_STRIDE));
+				RBuilder* b = OrphanRBuilder(opcode, (char*)"unnamed");
+				IlBuilder* bx = b;
+				cases.push_back(MakeCase(std::int32_t(opcode) + std::int32_t(s) * CACHE_STATE_STRIDE, &bx, false));
+				genSwitchHandlerBody(b, handler, state, s);
+			}
 		}
 		return cases;
 	}
 
 private:
 	HandlerTableBase* _handlers;
+	Dispatch _dispatch;
+	std::vector<std::vector<std::pair<std::int32_t, RBuilder*>>> _targets; //< threaded dispatch targets, by cache state, then opcode.
+	std::vector<IlBuilder*> _defaultTargets;                              //< threaded dispatch targets for unknown opcodes, by cache state.
+	Arena _arena;
 };
 
 }  // namespace JitBuilder
@@ -1,46 +1,83 @@
 #if !defined(OMR_JITBUILDER_BYTECODEMETHODBUILDER_HPP_)
 #define OMR_JITBUILDER_BYTECODEMETHODBUILDER_HPP_
 
+#include <OMR/Arena.hpp>
 #include <OMR/Model/Builder.hpp>
+#include <OMR/Model/Trace.hpp>
 
 #include <BytecodeHandlerTable.hpp>
 #include <MethodBuilder.hpp>
 #include <BytecodeBuilder.hpp>
 
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
 #include <functional>
-#include <map>
 #include <memory>
+#include <vector>
 
 namespace OMR {
 namespace JitBuilder {
 
+/// Static control flow facts about one bytecode.
+struct BytecodeInfo {
+	std::size_t length;  //< in bytes.
+	bool fallsThrough;   //< control may continue at the next bytecode.
+	bool branches;       //< control may transfer to target.
+	std::size_t target;  //< absolute index of the branch target.
+};
+
 /// Bytecode-driven method builder.
 class BytecodeMethodBuilder : public MethodBuilder {
 public:
-	BytecodeMethodBuilder(TypeDictionary* typeDictionary, BytecodeHandlerTableBase* handlers)
+	BytecodeMethodBuilder(TypeDictionary* typeDictionary, BytecodeHandlerTableBase* handlers = nullptr)
 		: MethodBuilder(typeDictionary)
-		, _handlers(handlers) {}
+		, _handlers(handlers)
+		, _builders()
+		, _arena() {}
 
+	/// Build IL with the dynamic handler table given at construction.
 	bool buildBytecodeIL() {
+		assert(_handlers != nullptr);
+		return buildBytecodeIL(*_handlers);
+	}
+
+	/// Build IL with any handler table: a BytecodeHandlerTableBase,
+	/// or a StaticBytecodeHandlerTable whose handlers inline into this loop.
+	/// Each basic block is compiled into one builder, bytecode after bytecode.
+	template <typename TableT>
+	bool buildBytecodeIL(TableT& handlers) {
+		findBlocks();
+		if (!analyzeBlocks()) {
+			return false;
+		}
 		AppendBuilder(_builders.get(this, 0));
-		std::int32_t index = -1;
-		while((index = GetNextBytecodeFromWorklist()) != -1) {
-			std::uint32_t opcode = getOpcode(index);
-			CBuilder* builder = _builders.get(this, index);
-			assert(index == builder->bcIndex());
-
-			fprintf(stderr, "@@@ *** compiling index=%u opcode=%u\n", index, opcode);
-			fprintf(stderr, "@@@ *** compiling bc-builder=%p vm-state=%p\n", builder, builder->vmState());
-	
-			builder->Call("print_s", 1, builder->Const((void*)"$$$ *** START index="));
-			builder->Call("print_u", 1, builder->Const((std::int32_t)index));
-			builder->Call("print_s", 1, builder->Const((void*)" opcode="));
-			builder->Call("print_u", 1, builder->Const((std::int32_t)opcode));
-			builder->Call("print_s", 1, builder->Const((void*)"\n"));
-
-			bool success = _handlers->invoke(builder, opcode);
-			if (!success) {
-				return false;
+		std::int32_t start = -1;
+		while((start = GetNextBytecodeFromWorklist()) != -1) {
+			CBuilder* builder = _builders.get(this, start);
+			assert(start == builder->bcIndex());
+
+			enterBlock(builder, start);
+
+			std::size_t index = start;
+			while (true) {
+				std::uint32_t opcode = getOpcode(index);
+				_builders.setCursor(index);
+
+				Model::Trace::staticValue(builder, "$$$ *** START index=", index);
+				Model::Trace::staticValue(builder, "$$$ *** START opcode=", opcode);
+
+				bool success = handlers.invoke(builder, opcode);
+				if (!success) {
+					return false;
+				}
+
+				BytecodeInfo info = decode(index);
+				std::size_t next = index + info.length;
+				if (info.branches || !info.fallsThrough || _builders.isLeader(next)) {
+					break; // end of block.
+				}
+				index = next;
 			}
 		}
 		return true;
@@ -48,11 +85,72 @@ public:
 
 	virtual std::uint32_t getOpcode(std::size_t index) = 0;
 
+	/// Called once the basic blocks are known, before any is compiled. The method's VM state
+	/// can still be set here: the entry block takes it over after this. Returns false to give
+	/// up on the compile, before any IL is built.
+	virtual bool analyzeBlocks() { return true; }
+
+	/// Called before the block starting at index is compiled into b. b's VM state is the
+	/// block's working copy of its entry state, so facts that hold on every path into the
+	/// block can be added to it.
+	virtual void enterBlock(OMR_UNUSED CBuilder* b, OMR_UNUSED std::size_t index) {}
+
+	/// Static control flow facts about the bytecode at index. Used to find basic blocks.
+	virtual BytecodeInfo decode(std::size_t index) = 0;
+
 	BytecodeBuilderTable* builders() { return &_builders; }
 
+	/// Memory for this compilation, freed in bulk when the builder is destroyed.
+	/// VM states should allocate their copies (MakeCopy) here.
+	Arena* arena() { return &_arena; }
+
 private:
+	/// Find the leaders of the basic blocks reachable from index 0: the entry,
+	/// every branch target, and every fallthrough after a branch.
+	void findBlocks() {
+		std::vector<std::size_t> worklist;
+		std::vector<bool> visited;
+
+		_builders.addLeader(0);
+		worklist.push_back(0);
+
+		while (!worklist.empty()) {
+			std::size_t index = worklist.back();
+			worklist.pop_back();
+
+			while (index >= visited.size() || !visited[index]) {
+				if (index >= visited.size()) {
+					visited.resize(index + 1, false);
+				}
+				visited[index] = true;
+
+				BytecodeInfo info = decode(index);
+				std::size_t next = index + info.length;
+
+				if (info.branches) {
+					_builders.addLeader(info.target);
+					worklist.push_back(info.target);
+					if (info.fallsThrough) {
+						_builders.addLeader(next);
+						worklist.push_back(next);
+					}
+					break;
+				}
+
+				if (!info.fallsThrough) {
+					break;
+				}
+
+				index = next;
+			}
+		}
+
+		_builders.numberBlocks();
+	}
+
 	BytecodeHandlerTableBase* _handlers;
 	BytecodeBuilderTable _builders;
+	Arena _arena;
 };
 
 }  // namespace JitBuilder
@@ -0,0 +1,105 @@
+#if !defined(OMR_GUARDEDSTACK_HPP_)
+#define OMR_GUARDEDSTACK_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace OMR {
+
+/// A stack in its own mapping, with an inaccessible guard page at each end.
+///
+/// Running off either end faults on a guard page instead of corrupting memory, so pushes
+/// and pops need no bounds checks. Catching the fault is up to the owner: see isGuard().
+class GuardedStack {
+public:
+	static std::size_t pageSize() {
+		static const std::size_t size = std::size_t(sysconf(_SC_PAGESIZE));
+		return size;
+	}
+
+	/// size in bytes, rounded up to whole pages. At least one page.
+	static std::size_t roundToPages(std::size_t size) {
+		std::size_t page = pageSize();
+		return size == 0 ? page : (size + page - 1) & ~(page - 1);
+	}
+
+	GuardedStack() : _mapping(nullptr), _mappingSize(0), _size(0) {}
+
+	/// A stack of at least size bytes, rounded up to whole pages. If hugePages is set,
+	/// the kernel is advised to back the stack with huge pages.
+	explicit GuardedStack(std::size_t size, bool hugePages = false) : GuardedStack() {
+		_size = roundToPages(size);
+		_mappingSize = _size + 2 * pageSize();
+
+		void* mapping = mmap(nullptr, _mappingSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mapping == MAP_FAILED) {
+			throw std::bad_alloc();
+		}
+		_mapping = static_cast<std::uint8_t*>(mapping);
+
+		if (mprotect(base(), _size, PROT_READ | PROT_WRITE) != 0) {
+			munmap(_mapping, _mappingSize);
+			_mapping = nullptr;
+			throw std::bad_alloc();
+		}
+
+#if defined(MADV_HUGEPAGE)
+		if (hugePages) {
+			madvise(base(), _size, MADV_HUGEPAGE);
+		}
+#endif
+	}
+
+	GuardedStack(const GuardedStack&) = delete;
+
+	GuardedStack(GuardedStack&& other) noexcept : GuardedStack() { swap(other); }
+
+	GuardedStack& operator=(const GuardedStack&) = delete;
+
+	GuardedStack& operator=(GuardedStack&& other) noexcept {
+		swap(other);
+		return *this;
+	}
+
+	~GuardedStack() {
+		if (_mapping != nullptr) {
+			munmap(_mapping, _mappingSize);
+		}
+	}
+
+	/// The lowest usable address. The stack grows up, from here.
+	std::uint8_t* base() const { return _mapping + pageSize(); }
+
+	/// One past the highest usable address. The upper guard page starts here.
+	std::uint8_t* limit() const { return base() + _size; }
+
+	/// Usable bytes.
+	std::size_t size() const { return _size; }
+
+	/// True if address lies in one of the guard pages.
+	bool isGuard(const void* address) const {
+		const std::uint8_t* p = static_cast<const std::uint8_t*>(address);
+		std::size_t page = pageSize();
+		return (_mapping <= p && p < base()) || (limit() <= p && p < limit() + page);
+	}
+
+	void swap(GuardedStack& other) noexcept {
+		std::swap(_mapping, other._mapping);
+		std::swap(_mappingSize, other._mappingSize);
+		std::swap(_size, other._size);
+	}
+
+private:
+	std::uint8_t* _mapping;   //< start of the lower guard page.
+	std::size_t _mappingSize; //< both guard pages and the stack, in bytes.
+	std::size_t _size;
+};
+
+}  // namespace OMR
+
+#endif // OMR_GUARDEDSTACK_HPP_
@@ -13,6 +13,7 @@
 #include <MethodBuilder.hpp>
 #include <BytecodeBuilder.hpp>
 
+#include <cstdint>
 #include <type_traits>
 
 #include <OMR/TypeTraits.hpp>
@@ -27,6 +28,7 @@ using CBuilder = JitBuilder::CBuilder;
 template <Mode> struct BuilderAlias;
 template <> struct BuilderAlias<Mode::REAL> : TypeAlias<RBuilder> {};
 template <> struct BuilderAlias<Mode::VIRT> : TypeAlias<CBuilder> {};
+template <> struct BuilderAlias<Mode::PURE> : TypeAlias<JitBuilder::IlBuilder> {}; //< only trace points, into a builder never appended.
 
 template <Mode M>
 using Builder = typename BuilderAlias<M>::Type;
@@ -60,12 +62,45 @@ CValue<T> add(JitBuilder::IlBuilder* b, CValue<U> lhs, RValue<U> rhs) {
 	return CValue<T>::pack(lhs.unpack() + rhs.unpack());
 }
 
-inline CInt64 add(JB::IlBuilder* b, CInt64 lhs, CInt64 rhs) {
-	return CInt64::pack(lhs.unpack() + rhs.unpack());
+/// The sum of two integers, wrapped like the IL Add.
+template <typename T>
+T wrappingAdd(T lhs, T rhs) {
+	using Unsigned = typename std::make_unsigned<T>::type;
+	return T(Unsigned(lhs) + Unsigned(rhs));
+}
+
+template <typename T>
+CValue<T> add(OMR_UNUSED JB::IlBuilder* b, CValue<T> lhs, CValue<T> rhs) {
+	return CValue<T>::pack(wrappingAdd(lhs.unpack(), rhs.unpack()));
+}
+
+template <typename T>
+RValue<T> add(JB::IlBuilder* b, RValue<T> lhs, RValue<T> rhs) {
+	return RValue<T>::pack(b->Add(lhs.unpack(), rhs.unpack()));
 }
 
-inline RInt64 add(JB::IlBuilder* b, RInt64 lhs, RInt64 rhs) {
-	return RInt64::pack(b->Add(lhs.unpack(), rhs.unpack()));
+/// Folded when both sides are known, or one is a known 0. Wraps, like the IL Add.
+template <typename T>
+KValue<T> add(JB::IlBuilder* b, KValue<T> lhs, KValue<T> rhs) {
+	if (lhs.isKnown() && rhs.isKnown()) {
+		return KValue<T>::known(wrappingAdd(lhs.value(), rhs.value()));
+	}
+	if (rhs.isKnown() && rhs.value() == 0) {
+		return lhs;
+	}
+	if (lhs.isKnown() && lhs.value() == 0) {
+		return rhs;
+	}
+	return KValue<T>::pack(b->Add(lhs.toIl(b), rhs.toIl(b)));
+}
+
+/// Known if both sides are. Generates nothing.
+template <typename T>
+PValue<T> add(OMR_UNUSED JB::IlBuilder* b, PValue<T> lhs, PValue<T> rhs) {
+	if (lhs.isKnown() && rhs.isKnown()) {
+		return PValue<T>::pack(wrappingAdd(lhs.unpack(), rhs.unpack()));
+	}
+	return PValue<T>();
 }
 
 #if 0
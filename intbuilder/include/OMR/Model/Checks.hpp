@@ -0,0 +1,63 @@
+#if !defined(OMR_MODEL_CHECKS_HPP_)
+#define OMR_MODEL_CHECKS_HPP_
+
+#include <OMR/Model.hpp>
+#include <OMR/Model/SlotType.hpp>
+#include <OMR/Model/Value.hpp>
+
+#include <IlBuilder.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// @group Debug check policies.
+/// Select one at build time by defining OMR_MODEL_CHECKED. Defaults to release.
+/// @{
+
+#if !defined(OMR_MODEL_CHECKED)
+#define OMR_MODEL_CHECKED 0
+#endif
+
+/// @}
+///
+
+namespace OMR {
+namespace Model {
+
+/// No debugging aids. Generated code only does what the VM semantics require.
+struct ReleaseChecks {
+	static constexpr bool ENABLED = false;
+
+	static void poison(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED JB::IlValue* address) {}
+
+	static void poisonMemory(OMR_UNUSED void* memory, OMR_UNUSED std::size_t size) {}
+};
+
+/// Dead VM memory is poisoned, so stale reads stand out: popped stack slots in generated
+/// code, and fresh stacks on the host side.
+struct CheckedChecks {
+	static constexpr bool ENABLED = true;
+
+	static constexpr SlotInt POISON_SLOT = 0xdead;       //< stored over popped slots.
+	static constexpr std::uint8_t POISON_BYTE = 0x5e;   //< fills fresh stack memory.
+
+	static void poison(JB::IlBuilder* b, JB::IlValue* address) {
+		b->StoreAt(address, constant(b, POISON_SLOT));
+	}
+
+	static void poisonMemory(void* memory, std::size_t size) {
+		std::memset(memory, POISON_BYTE, size);
+	}
+};
+
+#if OMR_MODEL_CHECKED
+using Checks = CheckedChecks;
+#else
+using Checks = ReleaseChecks;
+#endif
+
+}  // namespace Model
+}  // namespace OMR
+
+#endif // OMR_MODEL_CHECKS_HPP_
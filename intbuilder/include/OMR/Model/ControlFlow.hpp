@@ -3,10 +3,14 @@
 
 #include <OMR/Model/Mode.hpp>
 #include <OMR/Model/FunctionData.hpp>
+#include <OMR/Model/Register.hpp>
+#include <OMR/Model/Trace.hpp>
 
 #include <BytecodeBuilder.hpp>
 #include <BytecodeBuilderTable.hpp>
 
+#include <vector>
+
 namespace OMR {
 namespace Model {
 
@@ -18,41 +22,33 @@ class ControlFlow;
 template <>
 class ControlFlow<Mode::REAL> {
 public:
-	ControlFlow(FunctionData<Mode::REAL>& data) : _data(data), _address(nullptr) {}
+	ControlFlow(FunctionData<Mode::REAL>& data) : _data(data), _pc() {}
 
+	/// address is the pc's memory. The pc register is shared with the RealPc.
 	void initialize(JB::IlBuilder* b, JB::IlValue* address) {
-		_address = address;
+		_pc.initialize(b, "pc", b->typeDictionary()->toIlType<std::uint8_t*>(), address);
 	}
 
 	void next(RBuilder* b, JB::IlValue* index) {
-		std::fprintf(stderr, "#####test\n");
-		b->Call("print_s", 1, b->Const((void*)"$$$ ControlFlow next: index="));
-		b->Call("print_u", 1, index);
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+		Trace::value(b, "$$$ ControlFlow next: index=", index);
 
-		JB::TypeDictionary* t = b->typeDictionary();
-		JB::IlType* type = t->PointerTo(t->Int8);
-
-		b->StoreAt(_address, b->Add(base(), index));
+		_pc.store(b, b->Add(base(), index));
 		b->GotoEnd();
-		b->End()->Call("print_s", 1, b->End()->Const((void*) "$$$ AT END\n"));
+		Trace::message(b->End(), "$$$ AT END\n");
 		//b->End()->Return();
 	}
 
 	/// absolute control flow.
 	void IfCmpNotEqualZero(RBuilder* b, JB::IlValue* cond, JB::IlValue* index) {
-
-		b->Call("print_s", 1, b->Const((void*)"$$$ ControlFlow IfCmpNotEqualZero: cond= offset="));
-		b->Call("print_u", 1, index);
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+		Trace::value(b, "$$$ ControlFlow IfCmpNotEqualZero: offset=", index);
 
 		JB::TypeDictionary* t = b->typeDictionary();
 		JB::IlType* type = t->PointerTo(t->Int8);
 
 		JB::IlBuilder* onTrue = nullptr;
 		b->IfThen(&onTrue, cond);
-		onTrue->Call("print_s", 1, onTrue->Const((void*)"$$$ ON TRUE TAKEN !!! \n"));
-		onTrue->StoreAt(_address, onTrue->IndexAt(type, base(), index));
+		Trace::message(onTrue, "$$$ ON TRUE TAKEN !!! \n");
+		_pc.store(onTrue, onTrue->IndexAt(type, base(), index));
 		onTrue->Goto(b->End());
 	}
 
@@ -69,7 +65,7 @@ private:
 	JB::IlValue* base() const { return _data.start(); }
 
 	const FunctionData<Mode::REAL>& _data;
-	JB::IlValue* _address;
+	InterpreterRegister _pc;
 };
 
 template <>
@@ -77,23 +73,33 @@ class ControlFlow<Mode::VIRT> {
 public:
 	ControlFlow(FunctionData<Mode::VIRT>& data) : _address(nullptr), _data(data) {}
 
-	std::uintptr_t index(JB::BytecodeBuilder* b) const { return b->bcIndex(); }
+	std::uintptr_t index(OMR_UNUSED JB::BytecodeBuilder* b) const { return builders()->cursor(); }
 
 	void initialize(JB::IlBuilder* b, JB::IlValue* address)  {
 		_address = address;
 	}
 
+	/// Fall through to index. Within a basic block, the next bytecode is emitted into
+	/// the same builder, so only falling into a new block transfers control.
 	void next(JB::BytecodeBuilder* b, std::size_t index) {
-		fprintf(stderr, "@@@ control-flow: NEXT bc-index:=%u target-bc-index=%zu\n", b->bcIndex(), index);
-		b->AddFallThroughBuilder(builders()->get(b, index));
+		if (builders()->isLeader(index)) {
+			b->AddFallThroughBuilder(builders()->get(b, index));
+		}
 	}
 
 	/// absolute control flow.
 	void IfCmpNotEqualZero(JB::BytecodeBuilder* b, JB::IlValue* cond, std::size_t index) {
-		fprintf(stderr, "@@@ control-flow: IF_NOT_ZERO: bc-index:=%u target-bc-index=%zu\n", b->bcIndex(), index);
 		b->IfCmpNotEqualZero(builders()->get(b, index), cond);
 	}
 
+	/// Unconditional, absolute control flow. The block ends here.
+	void Goto(JB::BytecodeBuilder* b, std::size_t index) {
+		b->Goto(builders()->get(b, index));
+	}
+
+	/// True if control reaching index leaves the current block.
+	bool isLeader(std::size_t index) const { return builders()->isLeader(index); }
+
 	void halt(JB::IlBuilder* b) {
 		b->Return();
 	}
@@ -111,8 +117,52 @@ private:
 	JB::IlValue* _address;
 };
 
+/// Control flow in the PURE model generates nothing. It records the blocks that control
+/// can leave the current block for: the successors.
+template <>
+class ControlFlow<Mode::PURE> {
+public:
+	ControlFlow(FunctionData<Mode::PURE>& data) : _data(data), _successors(), _escapes(false) {}
+
+	/// Fall through to index. Only falling into a new block is an edge.
+	void next(OMR_UNUSED JB::IlBuilder* b, std::size_t index) {
+		if (isLeader(index)) {
+			_successors.push_back(index);
+		}
+	}
+
+	/// absolute control flow. The condition does not matter: either way, index is a successor.
+	void IfCmpNotEqualZero(OMR_UNUSED JB::IlBuilder* b, std::size_t index) {
+		_successors.push_back(index);
+	}
+
+	/// Unconditional, absolute control flow.
+	void Goto(OMR_UNUSED JB::IlBuilder* b, std::size_t index) {
+		_successors.push_back(index);
+	}
+
+	bool isLeader(std::size_t index) const { return _data.builders()->isLeader(index); }
+
+	/// The bytecode indexes of the blocks control can go to, recorded since the last clear.
+	const std::vector<std::size_t>& successors() const { return _successors; }
+
+	void clearSuccessors() { _successors.clear(); }
+
+	/// Something outside the function can see its frame, such as the host when control
+	/// halts, or a callee that is not inlined.
+	void escape() { _escapes = true; }
+
+	bool escapes() const { return _escapes; }
+
+private:
+	const FunctionData<Mode::PURE>& _data;
+	std::vector<std::size_t> _successors;
+	bool _escapes;
+};
+
 using VirtControlFlow = ControlFlow<Mode::VIRT>;
 using RealControlFlow = ControlFlow<Mode::REAL>;
+using PureControlFlow = ControlFlow<Mode::PURE>;
 
 }  // namespace Model
 }  // namespace OMR
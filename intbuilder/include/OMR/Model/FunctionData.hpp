@@ -43,6 +43,22 @@ private:
 	JB::BytecodeBuilderTable* _builders;
 };
 
+/// The PURE model walks the same blocks as the VIRT compile, with the same cursor.
+template <>
+class FunctionData<Mode::PURE> {
+public:
+	FunctionData(PPtr<std::uint8_t> start, JB::BytecodeBuilderTable* builders)
+		: _start(start.unpack()), _builders(builders) {}
+
+	std::uint8_t* start() const { return _start; }
+
+	JB::BytecodeBuilderTable* builders() const { return _builders; }
+
+private:
+	std::uint8_t* _start;
+	JB::BytecodeBuilderTable* _builders;
+};
+
 }  // namespace Model
 }  // namespace OMR
 
@@ -1,12 +1,18 @@
 #if !defined(OMR_MODEL_OPERANDARRAY_HPP_)
 #define OMR_MODEL_OPERANDARRAY_HPP_
 
+#include <OMR/Model/Slot.hpp>
+#include <OMR/Model/SlotType.hpp>
+#include <OMR/Arena.hpp>
+#include <OMR/PersistentVector.hpp>
 #include <OMR/Model/Value.hpp>
 
 #include <IlBuilder.hpp>
 #include <IlType.hpp>
 #include <TypeDictionary.hpp>
 
+#include <cassert>
+#include <type_traits>
 #include <vector>
 
 namespace OMR {
@@ -17,23 +23,47 @@ public:
 	RealOperandArray() :
 		_type(nullptr), _ptype(nullptr), _addr(nullptr), _length(nullptr) {}
 
-	void initialize(JB::IlBuilder* b, JB::IlType* type, JB::IlValue* addr, RSize length) {
+	void initialize(JB::IlBuilder* b, JB::IlType* type, JB::IlValue* addr, RSize length, OMR_UNUSED Arena* arena = nullptr) {
 		_type = type;
 		_ptype = b->typeDictionary()->PointerTo(type);
 		_addr = addr;
 		_length = length.unpack();
 	}
 
-	void set(JB::IlBuilder* b, RSize index, JB::IlValue* value) {
-		b->StoreAt(b->IndexAt(_ptype, _addr, index.unpack()), value);
+	void set(JB::IlBuilder* b, RSize index, RSlotInt value) {
+		b->StoreAt(b->IndexAt(_ptype, _addr, index.unpack()), value.unpack());
 	}
 
-	JB::IlValue* get(JB::IlBuilder* b, RSize index) {
-		return b->LoadAt(_ptype, b->IndexAt(_ptype, _addr, index.unpack()));
+	RSlotInt get(JB::IlBuilder* b, RSize index) {
+		return RSlotInt::pack(b->LoadAt(_ptype, b->IndexAt(_ptype, _addr, index.unpack())));
+	}
+
+	/// Set an element to a value of type T, which must fit in a slot. Stored as T.
+	template <typename T>
+	void set(JB::IlBuilder* b, RSize index, RValue<T> value) {
+		static_assert(sizeof(T) <= SLOT_SIZE, "value does not fit in a slot");
+		b->StoreAt(b->IndexAt(_ptype, _addr, index.unpack()), value.unpack());
+	}
+
+	/// Get an element as a value of type T.
+	template <typename T>
+	RValue<T> get(JB::IlBuilder* b, RSize index) {
+		JB::IlType* ptype = b->typeDictionary()->PointerTo(slotIlType<T>(b->typeDictionary()));
+		return RValue<T>::pack(b->LoadAt(ptype, b->IndexAt(_ptype, _addr, index.unpack())));
 	}
 
 	RSize length() const { return RSize::pack(_length); }
 
+	/// The address of the zeroth element.
+	JB::IlValue* address() const { return _addr; }
+
+	/// Move the array to addr, with length elements, as when the generated interpreter
+	/// switches frames. Every copy sees the move, from here on.
+	void rebase(JB::IlBuilder* b, JB::IlValue* addr, RSize length) {
+		b->StoreOver(_addr, addr);
+		b->StoreOver(_length, length.unpack());
+	}
+
 	void commit(JB::IlBuilder* b) {}
 
 	void reload(JB::IlBuilder* b) {}
@@ -50,59 +80,203 @@ private:
 	JB::IlValue* _length;
 };
 
+/// Buffered array of values, such as the locals. Slots are loaded on first use, and
+/// only slots set since they were last loaded or committed are stored back to memory.
+/// A slot set to a known value stays known until control leaves the block.
 class VirtOperandArray {
 public:
+	using SlotVector = PersistentVector<Slot>;
+
 	VirtOperandArray() : _type(nullptr), _ptype(nullptr), _addr(nullptr), _values() {}
 
-	void initialize(JB::IlBuilder* b, JB::IlType* type, JB::IlValue* addr, CSize length) {
+	/// Slots are allocated in arena. Copies share slots until they are written.
+	void initialize(JB::IlBuilder* b, JB::IlType* type, JB::IlValue* addr, CSize length, Arena* arena) {
 		_type = type;
 		_ptype = b->typeDictionary()->PointerTo(_type);
 		_addr = addr;
-		_values.assign(length.unpack(), nullptr);
+		_values = SlotVector(length.unpack(), Slot::inMemory(), arena);
 	}
 
-	void set(JB::IlBuilder* b, CSize index, JB::IlValue* value) {
-		_values.at(index.unpack()) = value;
+	/// An array with no memory behind it, such as an inlined callee's locals, or the locals
+	/// of a function compiled without a frame. Every slot starts out holding fill. The slots
+	/// only ever live in IL values: they are all dirty, so merges never touch memory, and
+	/// commit and reload do nothing.
+	void initializeUnbacked(JB::IlBuilder* b, JB::IlType* type, CSize length, KSlotInt fill, Arena* arena) {
+		_type = type;
+		_ptype = b->typeDictionary()->PointerTo(_type);
+		_addr = nullptr;
+		_values = SlotVector(length.unpack(), Slot::dirty(fill), arena);
 	}
 
-	JB::IlValue* get(JB::IlBuilder* b, CSize index) {
-		return _values.at(index.unpack());
+	bool isBacked() const { return _addr != nullptr; }
+
+	void set(JB::IlBuilder* b, CSize index, KSlotInt value) {
+		_values.set(index.unpack(), Slot::dirty(value));
+	}
+
+	KSlotInt get(JB::IlBuilder* b, CSize index) {
+		return slotValue(b, index.unpack(), nullptr);
+	}
+
+	/// Set an element to a value of type T, which must fit in a slot. A value that is not a
+	/// SlotInt keeps its own IL type. See Slot.
+	template <typename T>
+	void set(JB::IlBuilder* b, CSize index, KValue<T> value) {
+		_values.set(index.unpack(), Slot::dirty(Slot::encode(b, value), typeOf<T>(b)));
+	}
+
+	/// Get an element as a value of type T: the type it was set with.
+	template <typename T>
+	KValue<T> get(JB::IlBuilder* b, CSize index) {
+		return Slot::decode<T>(slotValue(b, index.unpack(), typeOf<T>(b)));
 	}
 
 	CSize length() const { return CSize::pack(_values.size()); }
 
 	void commit(JB::IlBuilder* b) {
+		if (!isBacked()) {
+			return;
+		}
 		for (std::size_t i = 0; i < _values.size(); ++i) {
-			JB::IlValue* value = _values.at(i);
-			if (value != nullptr) {
-				b->StoreAt(b->IndexAt(_ptype, _addr, b->Const((std::int64_t)i)), value);
+			if (_values[i].isDirty()) {
+				Slot& slot = _values.mutableAt(i);
+				b->StoreAt(address(b, i), slot.value.toIl(b));
+				slot.state = Slot::State::CLEAN;
 			}
 		}
 	}
 
-	void reload(JB::IlBuilder* b) {
+	/// Assume the index'th element holds value. Only valid on entry to a block, if every
+	/// path into it leaves value there.
+	void assume(std::size_t index, SlotInt value) {
+		_values.mutableAt(index).assume(value);
+	}
+
+	/// Give every known value its IL, in b. See Slot.
+	void materializeKnown(JB::IlBuilder* b) {
 		for (std::size_t i = 0; i < _values.size(); ++i) {
-			_values.at(i) =  b->LoadAt(_ptype, b->IndexAt(_ptype, _addr, b->Const((std::int64_t)i)));
+			if (_values[i].isKnown()) {
+				_values.mutableAt(i).materialize(b);
+			}
+		}
+	}
+
+	/// Forget the buffered values. Each slot is loaded again on its next use.
+	void reload(OMR_UNUSED JB::IlBuilder* b) {
+		if (!isBacked()) {
+			return;
+		}
+		for (std::size_t i = 0; i < _values.size(); ++i) {
+			if (!_values[i].isInMemory()) {
+				_values.set(i, Slot::inMemory());
+			}
 		}
 	}
 
 	void mergeInto(JB::IlBuilder* b, VirtOperandArray& dest) {
 		for (std::size_t i = 0; i < _values.size(); ++i) {
-			b->StoreOver(dest._values[i], _values[i]);
+			const Slot& slot = _values[i];
+			const Slot& target = dest._values[i];
+			bool touchesMemory = slot.needsEdgeStore(target) || slot.needsEdgeLoad(target);
+			slot.mergeInto(b, target, _ptype, touchesMemory ? address(b, i) : nullptr);
 		}
 	}
 
 private:
+	JB::IlValue* address(JB::IlBuilder* b, std::size_t index) const {
+		return b->IndexAt(_ptype, _addr, b->Const((std::int64_t)index));
+	}
+
+	/// The value of element i, loading it on first use as a value of type: nullptr for SlotInt.
+	KSlotInt slotValue(JB::IlBuilder* b, std::size_t i, JB::IlType* type) {
+		if (_values.at(i).isInMemory()) {
+			JB::IlType* ptype = type != nullptr ? b->typeDictionary()->PointerTo(type) : _ptype;
+			return _values.mutableAt(i).load(b, ptype, address(b, i), type);
+		}
+		assert(_values[i].type == type);
+		return _values[i].value;
+	}
+
+	/// The slot type of T: nullptr for SlotInt, which is the array's own element type.
+	template <typename T>
+	static JB::IlType* typeOf(JB::IlBuilder* b) {
+		JB::IlType* type = slotIlType<T>(b->typeDictionary());
+		return std::is_same<T, SlotInt>::value ? nullptr : type;
+	}
+
 	JB::IlType* _type;
 	JB::IlType* _ptype;
 	JB::IlValue* _addr;
-	std::vector<JB::IlValue*> _values;
+	SlotVector _values;
 };
 
+/// Tracks what is known about each element, for the PURE model. Generates nothing.
 class PureOperandArray {
-	// TODO RWY
+public:
+	PureOperandArray() : _values() {}
+
+	/// Every element starts out unknown.
+	void initialize(std::size_t length) {
+		_values.assign(length, PSlotInt());
+	}
+
+	void set(OMR_UNUSED JB::IlBuilder* b, PSize index, PSlotInt value) {
+		_values.at(index.unpack()) = value;
+	}
+
+	PSlotInt get(OMR_UNUSED JB::IlBuilder* b, PSize index) const {
+		return _values.at(index.unpack());
+	}
+
+	/// Set an element to a value of type T. Only SlotInt values are tracked: any other is unknown.
+	template <typename T>
+	void set(OMR_UNUSED JB::IlBuilder* b, PSize index, OMR_UNUSED PValue<T> value) {
+		static_assert(sizeof(T) <= SLOT_SIZE, "value does not fit in a slot");
+		_values.at(index.unpack()) = PSlotInt();
+	}
+
+	template <typename T>
+	PValue<T> get(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED PSize index) const {
+		static_assert(sizeof(T) <= SLOT_SIZE, "value does not fit in a slot");
+		return PValue<T>();
+	}
+
+	std::size_t length() const { return _values.size(); }
+
+	/// Join other into this array. Returns true if this array changed.
+	bool join(const PureOperandArray& other) {
+		assert(other._values.size() == _values.size());
+		bool changed = false;
+		for (std::size_t i = 0; i < _values.size(); ++i) {
+			PSlotInt joined = _values[i].join(other._values[i]);
+			if (joined != _values[i]) {
+				_values[i] = joined;
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	void commit(OMR_UNUSED JB::IlBuilder* b) {}
+
+	void reload(OMR_UNUSED JB::IlBuilder* b) {}
+
+	void mergeInto(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED PureOperandArray& dest) {}
+
+private:
+	std::vector<PSlotInt> _values;
 };
 
+template <>
+inline void PureOperandArray::set<SlotInt>(JB::IlBuilder* b, PSize index, PSlotInt value) {
+	set(b, index, value);
+}
+
+template <>
+inline PSlotInt PureOperandArray::get<SlotInt>(JB::IlBuilder* b, PSize index) const {
+	return get(b, index);
+}
+
 template <Mode M>
 struct ModalOperandArrayAlias;
 
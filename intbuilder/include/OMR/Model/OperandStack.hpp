@@ -1,225 +1,604 @@
 #if !defined(OMR_MODEL_VIRTOPERANDSTACK_HPP_)
 #define OMR_MODEL_VIRTOPERANDSTACK_HPP_
 
+#include <OMR/Model/Checks.hpp>
 #include <OMR/Model/Mode.hpp>
 #include <OMR/Model/Value.hpp>
 #include <OMR/Model/Register.hpp>
+#include <OMR/Model/Slot.hpp>
+#include <OMR/Model/SlotType.hpp>
+#include <OMR/Model/Trace.hpp>
+#include <OMR/Arena.hpp>
+#include <OMR/PersistentVector.hpp>
 #include <OMR/TypeTraits.hpp>
 
 #include <IlBuilder.hpp>
 #include <TypeDictionary.hpp>
 
 #include <cstdint>
+#include <type_traits>
 #include <vector>
 
 namespace OMR {
 namespace Model {
 
+/// The compile-time operand stack. Pushed values are buffered in _values, and the SP is
+/// tracked as a static byte offset from the SP held in the _sp register. The pointer
+/// arithmetic is only emitted when the SP is needed: at commits, merges and reserves.
 class VirtOperandStack {
 public:
+	using SlotVector = PersistentVector<Slot>;
+
 	VirtOperandStack() :
-		_etype(nullptr), _ptype(nullptr), _sp(), _values() {}
+		_etype(nullptr), _ptype(nullptr), _sp(), _delta(0), _values() {}
 
-	VirtOperandStack(const VirtOperandStack& other)
-		: _etype(other._etype), _ptype(other._ptype), _sp(other._sp), _values(other._values) {
-		fprintf(stderr, "@@@ VIRT OPERAND STACK COPY depth=%zu\n", _values.size());
-	}
+	/// Constant time: the buffered slots are shared until written.
+	VirtOperandStack(const VirtOperandStack& other) = default;
 
-	void initialize(JB::IlBuilder* b, JB::IlType* etype, JB::IlValue* address) {
+	/// Buffered slots are allocated in arena.
+	void initialize(JB::IlBuilder* b, JB::IlType* etype, JB::IlValue* address, Arena* arena) {
 		JB::TypeDictionary* t = b->typeDictionary();
 		_etype = etype;
 		_ptype = t->PointerTo(_etype);
 		_sp.initialize(b, _ptype, address);
+		_delta = 0;
+		_values = SlotVector(arena);
 	}
 
+	/// Store the dirty slots, and the SP if it moved.
 	void commit(JB::IlBuilder* b) {
-		b->Call("print_s", 1, b->Const((void*)"$$$ VirtOperandStack: commit\n"));
+		Trace::message(b, "$$$ VirtOperandStack: commit\n");
 
-		std::size_t n = _values.size();
+		materialize(b);
 
-		JB::IlValue* ptr = b->Sub(_sp.load(b), b->Const(8)); // Roll SP down to first slot.
-		for(std::size_t i = 0; i < n; ++i) {
+		for(std::size_t i = 0; i < _values.size(); ++i) {
+			if (!_values[i].isDirty()) {
+				continue;
+			}
 
-			auto tgt = b->IndexAt(_ptype, ptr, b->Const(0 - (std::int64_t)i));
-			auto val = _values[n - i - 1];
+			Slot& slot = _values.mutableAt(i);
+			JB::IlValue* tgt = slotAddress(b, i);
 
-			b->Call("print_s", 1, b->Const((void*)"$$$ VirtOperandStack: commit: store: addr="));
-			b->Call("print_x", 1, tgt);
-			b->Call("print_s", 1, b->Const((void*)" val="));
-			b->Call("print_u", 1, val);
-			b->Call("print_s", 1, b->Const((void*)"\n"));
+			JB::IlValue* value = slot.value.toIl(b);
 
-			b->StoreAt(tgt, val);
+			Trace::value(b, "$$$ VirtOperandStack: commit: store: addr=", tgt);
+			Trace::value(b, "$$$ VirtOperandStack: commit: store: val=", value);
+
+			b->StoreAt(tgt, value);
+			slot.state = Slot::State::CLEAN;
 		}
 		_sp.commit(b);
 	}
 
+	/// Reload the SP. The buffered slots are loaded again on their next use.
 	void reload(JB::IlBuilder* b) {
 		_sp.reload(b);
+		_delta = 0;
 
-		const std::size_t nslots = _values.size();
-		JB::IlValue* const ptr = b->Sub(_sp.load(b), b->Const(8)); // Roll SP down to first slot.
+		for (std::size_t i = 0; i < _values.size(); ++i) {
+			if (!_values[i].isInMemory()) {
+				_values.set(i, Slot::inMemory());
+			}
+		}
+	}
 
-		for(std::size_t i = 0; i < _values.size(); ++i) {
-			JB::IlValue* slotptr = b->IndexAt(_ptype, ptr, b->Const(0 - (std::int64_t)i));
-			_values[nslots - i - 1] = b->LoadAt(_ptype, slotptr);
+	/// Assume the i'th buffered element, counting from the bottom, holds value. Only valid on
+	/// entry to a block, if every path into it leaves value there.
+	void assume(std::size_t i, SlotInt value) {
+		_values.mutableAt(i).assume(value);
+	}
+
+	/// Give every known value its IL, in b. See Slot.
+	void materializeKnown(JB::IlBuilder* b) {
+		for (std::size_t i = 0; i < _values.size(); ++i) {
+			if (_values[i].isKnown()) {
+				_values.mutableAt(i).materialize(b);
+			}
 		}
 	}
 
 	void mergeInto(JB::IlBuilder* b, VirtOperandStack& dest) {
 
-		b->Call("print_s", 1, b->Const((void*)"$$$ VirtOperandStack: merge into X\n"));
-
-		_sp.mergeInto(b, dest._sp);
+		Trace::message(b, "$$$ VirtOperandStack: merge into X\n");
 
 		assert(dest._values.size() == _values.size());
 
 		for(std::size_t i = 0; i < _values.size(); ++i) {
-			b->StoreOver(dest._values[i], _values[i]);
+			const Slot& slot = _values[i];
+			const Slot& target = dest._values[i];
+			bool touchesMemory = slot.needsEdgeStore(target) || slot.needsEdgeLoad(target);
+			slot.mergeInto(b, target, _ptype, touchesMemory ? slotAddress(b, i) : nullptr);
+		}
+
+		if (_delta == dest._delta) {
+			_sp.mergeInto(b, dest._sp);
+		} else {
+			// Rebase our SP, so that dest's static offset still holds on this edge.
+			VirtRegister rebased = _sp;
+			rebased.store(b, b->Add(_sp.load(b), b->Const(_delta - dest._delta)));
+			rebased.mergeInto(b, dest._sp);
 		}
 	}
 
-	/// reserve n 64bit elements on the stack. Returns a pointer to the zeroth element.
+	/// reserve n slots on the stack. Returns a pointer to the zeroth slot.
 	/// In the virtual operand stack, this is "unbuffered" storage left on the stack.
-	JB::IlValue* reserve64(JB::IlBuilder* b, CSize nelements) {
-		JB::IlValue* start = _sp.load(b);
-		_sp.store(b, b->Add(start, b->Mul(b->ConstInt64(8), nelements.toIl(b))));
+	JB::IlValue* reserve(JB::IlBuilder* b, CSize nelements) {
+		JB::IlValue* start = sp(b);
+		_delta += std::int64_t(SLOT_SIZE * nelements.unpack());
 
-		b->Call("print_s", 1, b->Const((void*)"$$$ VirtOperandStack: reserve64: nelements="));
-		b->Call("print_u", 1, nelements.toIl(b));
-		b->Call("print_s", 1, b->Const((void*)" new-sp="));
-		b->Call("print_x", 1, _sp.load(b));
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+		Trace::staticValue(b, "$$$ VirtOperandStack: reserve: nelements=", nelements.unpack());
+		Trace::staticValue(b, "$$$ VirtOperandStack: reserve: sp-delta=", _delta);
 
 		return start;
 	}
 
-	void pushInt64(JB::IlBuilder *b, JB::IlValue *value) {
-		_values.push_back(value);
-		_sp.store(b, b->Add(_sp.load(b), b->Const(8))); // TODO RWY: Using magic constant (sizeof int64)
+	/// Reserve a frame of nlocals slots, whose first nparams slots are already on the stack.
+	/// Returns a pointer to the zeroth slot. Only valid before anything is pushed.
+	JB::IlValue* reserveFrame(JB::IlBuilder* b, CSize nparams, CSize nlocals) {
+		assert(_values.size() == 0);
+		_delta -= std::int64_t(SLOT_SIZE * nparams.unpack());
+		return reserve(b, CSize::pack(nlocals.unpack() - nparams.unpack()));
+	}
 
-		b->Call("print_s", 1, b->Const((void*)"$$$ VirtOperandStack: pushInt64: value="));
-		b->Call("print_u", 1, value);
-		b->Call("print_s", 1, b->Const((void*)" new-sp="));
-		b->Call("print_x", 1, _sp.load(b));
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+	/// The address of the n slots the caller left on the stack, such as a callee's arguments,
+	/// without taking them. Only valid before anything is pushed.
+	JB::IlValue* arguments(JB::IlBuilder* b, CSize n) {
+		assert(_values.size() == 0);
+		return b->IndexAt(_ptype, sp(b), b->Const(-std::int64_t(n.unpack())));
 	}
 
-	JB::IlValue* peek(OMR_UNUSED JB::IlBuilder& b, CUInt offset) {
-		return _values.at(offset.unpack());
+	/// Drop every buffered slot, and move the SP to address. Used when the frame is popped.
+	void reset(JB::IlBuilder* b, JB::IlValue* address) {
+		_values.clear();
+		_delta = 0;
+		_sp.store(b, b->ConvertTo(_ptype, address));
 	}
 
-	JB::IlValue* popInt64(JB::IlBuilder *b) {
+	void push(JB::IlBuilder *b, KSlotInt value) {
+		_values.push_back(Slot::dirty(value));
+		_delta += SLOT_SIZE;
 
-		_sp.store(b, b->Sub(_sp.load(b), b->Const(8))); // TODO RWY: Using magic constant sizeof int64 
-		JB::IlValue* value = top(b);
+		trace(b, "$$$ VirtOperandStack: push: value=", value);
+		Trace::staticValue(b, "$$$ VirtOperandStack: push: sp-delta=", _delta);
+	}
+
+	/// Push a value of type T, which must fit in a slot. A value that is not a SlotInt keeps
+	/// its own IL type, so a double stays a double until it is stored.
+	template <typename T>
+	void push(JB::IlBuilder* b, KValue<T> value) {
+		_values.push_back(Slot::dirty(Slot::encode(b, value), typeOf<T>(b)));
+		_delta += SLOT_SIZE;
+
+		Trace::staticValue(b, "$$$ VirtOperandStack: push: sp-delta=", _delta);
+	}
+
+	/// Pop a value of type T: the type it was pushed with.
+	template <typename T>
+	KValue<T> pop(JB::IlBuilder* b) {
+		KSlotInt value = slotValue(b, _values.size() - 1, typeOf<T>(b));
+		_delta -= SLOT_SIZE;
+		_values.pop_back();
+
+		Trace::staticValue(b, "$$$ VirtOperandStack: pop: sp-delta=", _delta);
+
+		return Slot::decode<T>(value);
+	}
+
+	KSlotInt peek(JB::IlBuilder& b, CUInt offset) {
+		return slotValue(&b, offset.unpack());
+	}
+
+	KSlotInt pop(JB::IlBuilder *b) {
+
+		KSlotInt value = top(b);
+		_delta -= SLOT_SIZE;
 		_values.pop_back();
 
-		b->Call("print_s", 1, b->Const((void*)"$$$ VirtOperandStack: popInt64: value="));
-		b->Call("print_u", 1, value);
-		b->Call("print_s", 1, b->Const((void*)" new-sp="));
-		b->Call("print_x", 1, _sp.load(b));
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+		trace(b, "$$$ VirtOperandStack: pop: value=", value);
+		Trace::staticValue(b, "$$$ VirtOperandStack: pop: sp-delta=", _delta);
 
 		return value;
 	}
 
-	JB::IlValue* top(JB::IlBuilder* b) {
+	KSlotInt top(JB::IlBuilder* b) {
 		assert(0 < _values.size());
-		return _values.at(_values.size() - 1);
+		return slotValue(b, _values.size() - 1);
+	}
+
+	/// Commit the stack with a gap of n slots opened under the top depth slots, and return
+	/// the gap's address. Afterwards the buffered stack ends at the gap: the moved slots
+	/// belong to whatever the gap was made for, such as a callee's frame. Slots are moved
+	/// whatever their type.
+	JB::IlValue* insert(JB::IlBuilder* b, CSize depth, CSize n) {
+		std::vector<KSlotInt> moved(depth.unpack());
+		for (std::size_t i = moved.size(); i > 0; --i) {
+			moved[i - 1] = slotValue(b, _values.size() - 1, _values.back().type);
+			_delta -= SLOT_SIZE;
+			_values.pop_back();
+		}
+		commit(b);
+
+		JB::IlValue* gap = _sp.load(b);
+		for (std::size_t i = 0; i < moved.size(); ++i) {
+			b->StoreAt(b->IndexAt(_ptype, gap, b->Const(std::int64_t(n.unpack() + i))), moved[i].toIl(b));
+		}
+
+		// Store the SP past the moved elements, but keep the buffered stack's view at the gap.
+		std::int64_t bytes = std::int64_t(SLOT_SIZE * (n.unpack() + moved.size()));
+		_delta = bytes;
+		materialize(b);
+		_sp.commit(b);
+		_delta = -bytes;
+
+		Trace::staticValue(b, "$$$ VirtOperandStack: insert: sp-delta=", _delta);
+
+		return gap;
 	}
 
+	/// Something behind our back, such as a callee's RETURN, pushed one element at the SP of
+	/// the buffered stack, and stored the SP past it. Reload the SP, and buffer the element
+	/// as in memory.
+	void returned(JB::IlBuilder* b) {
+		_sp.reload(b);
+		_delta = 0;
+		_values.push_back(Slot::inMemory());
+	}
+
+	/// The number of buffered elements.
+	std::size_t depth() const { return _values.size(); }
+
+	/// The static offset, in bytes, of the current SP from the SP in the register.
+	std::int64_t delta() const { return _delta; }
+
 private:
+	/// The current SP. Emits the pointer arithmetic for the pending offset, if any.
+	JB::IlValue* sp(JB::IlBuilder* b) {
+		JB::IlValue* base = _sp.load(b);
+		if (_delta == 0) {
+			return base;
+		}
+		return b->Add(base, b->Const(_delta));
+	}
+
+	/// The address of the i'th buffered slot, counting from the bottom.
+	JB::IlValue* slotAddress(JB::IlBuilder* b, std::size_t i) {
+		std::int64_t offset = std::int64_t(i) - std::int64_t(_values.size());
+		return b->IndexAt(_ptype, sp(b), b->Const(offset));
+	}
+
+	/// The value of the i'th buffered slot, loading it on first use as a value of type:
+	/// nullptr for SlotInt.
+	KSlotInt slotValue(JB::IlBuilder* b, std::size_t i, JB::IlType* type = nullptr) {
+		if (_values.at(i).isInMemory()) {
+			JB::IlType* ptype = type != nullptr ? b->typeDictionary()->PointerTo(type) : _ptype;
+			return _values.mutableAt(i).load(b, ptype, slotAddress(b, i), type);
+		}
+		assert(_values[i].type == type);
+		return _values[i].value;
+	}
+
+	/// The slot type of T: nullptr for SlotInt, which is the stack's own element type.
+	template <typename T>
+	static JB::IlType* typeOf(JB::IlBuilder* b) {
+		JB::IlType* type = slotIlType<T>(b->typeDictionary());
+		return std::is_same<T, SlotInt>::value ? nullptr : type;
+	}
+
+	/// Trace a value, without making IL for a known one.
+	static void trace(JB::IlBuilder* b, const char* message, KSlotInt value) {
+		if (value.isKnown()) {
+			Trace::staticValue(b, message, value.value());
+		} else {
+			Trace::value(b, message, value.unpack());
+		}
+	}
+
+	/// Fold the pending offset into the SP register.
+	void materialize(JB::IlBuilder* b) {
+		if (_delta != 0) {
+			_sp.store(b, sp(b));
+			_delta = 0;
+		}
+	}
+
 	JB::IlType* _etype;
 	JB::IlType* _ptype;
 	VirtRegister _sp;
-	std::vector<JB::IlValue*> _values;
+	std::int64_t _delta; //< in bytes.
+	SlotVector _values;
 };
 
 /// grows upwards, store before increment / load after decrement.
+/// The SP is an InterpreterRegister: commit before anything reads the stack's memory.
 ///
+/// With a top cache, the top element can be held in the "tos" local instead of memory, so
+/// a push followed by a pop never touches memory. Whether it is held there is static: known
+/// at every point of the generated code, as the cached count. The generated interpreter
+/// builds each handler once per count it can be entered with. Only SlotInt elements are
+/// cached: everything but the untyped push and pop spills the cache first, and commit
+/// spills it too.
 class RealOperandStack {
 public:
-	RealOperandStack() : _sp() {}
+	static constexpr std::size_t MAX_CACHED = 1;
+
+	RealOperandStack() : _sp(), _cacheSize(0), _cached(0) {}
 
 	RealOperandStack(const RealOperandStack&) = default;
 
-	void initialize(JB::IlBuilder* b, JB::IlType* etype, JB::IlValue* address) {
+	void initialize(JB::IlBuilder* b, JB::IlType* etype, JB::IlValue* address, OMR_UNUSED Arena* arena = nullptr) {
 		_typedict = b->typeDictionary();
 		_etype = etype;
 		_ptype = _typedict->PointerTo(_etype);
-		_sp.initialize(b, _ptype, address);
+		_sp.initialize(b, "sp", _ptype, address);
+		_sp.reload(b);
+		_cacheSize = 0;
+		_cached = 0;
+	}
+
+	/// Allow up to size elements to be cached, at most MAX_CACHED. 0 disables the cache.
+	void setCacheSize(std::size_t size) {
+		assert(size <= MAX_CACHED);
+		_cacheSize = size;
+	}
+
+	std::size_t cacheSize() const { return _cacheSize; }
+
+	/// The number of top elements held in locals, rather than memory.
+	std::size_t cached() const { return _cached; }
+
+	/// Assume the top n elements are held in locals. Used to enter a handler's variant.
+	void setCached(std::size_t n) {
+		assert(n <= _cacheSize);
+		_cached = n;
+	}
+
+	/// Store the cached elements to memory.
+	void spill(JB::IlBuilder* b) {
+		if (_cached == 0) {
+			return;
+		}
+		JB::IlValue* sp = _sp.load(b);
+		b->StoreAt(sp, b->Load("tos"));
+		_sp.store(b, b->ConvertTo(_ptype, b->Add(sp, constant(b, std::int64_t(SLOT_SIZE)))));
+		_cached = 0;
+
+		Trace::message(b, "$$$ RealOperandStack: spill\n");
 	}
 
 	void commit(JB::IlBuilder* b) {
+		spill(b);
 		_sp.commit(b);
 	}
 
 	void reload(JB::IlBuilder* b) {
 		_sp.reload(b);
+		_cached = 0;
 	}
 
 	void mergeInto(JB::IlBuilder* b, RealOperandStack& dest) {
 		_sp.mergeInto(b, dest._sp);
 	}
 
-	JB::IlValue* popInt64(JB::IlBuilder* b) {
-		JB::IlValue* sp = b->Sub(_sp.load(b), constant(b, 8)); // TODO RWY: Using magic number (sizeof int64)
-		JB::IlValue* value = b->LoadAt(_typedict->pInt64, sp);
-		b->StoreAt(sp, constant(b, std::int64_t(0xdead))); // poison
+	RSlotInt pop(JB::IlBuilder* b) {
+		if (_cached != 0) {
+			JB::IlValue* value = b->Load("tos");
+			_cached = 0;
+			Trace::value(b, "$$$ RealOperandStack: pop: cached value=", value);
+			return RSlotInt::pack(value);
+		}
+
+		JB::IlValue* sp = b->Sub(_sp.load(b), constant(b, std::int64_t(SLOT_SIZE)));
+		JB::IlValue* value = b->LoadAt(_ptype, sp);
+		Checks::poison(b, sp);
 		_sp.store(b, sp);
 
-		b->Call("print_s", 1, b->Const((void*)"$$$ RealOperandStack: popInt64: value="));
-		b->Call("print_u", 1, value);
-		b->Call("print_s", 1, b->Const((void*)" new-sp="));
-		b->Call("print_x", 1, _sp.load(b));
-		b->Call("print_s", 1, b->Const((void*)"\n"));
-	
-		return value;
+		Trace::value(b, "$$$ RealOperandStack: pop: value=", value);
+		Trace::value(b, "$$$ RealOperandStack: pop: new-sp=", sp);
+
+		return RSlotInt::pack(value);
 	}
 
-	void pushInt64(JB::IlBuilder* b, JB::IlValue* value) {
+	void push(JB::IlBuilder* b, RSlotInt operand) {
+		JB::IlValue* value = operand.unpack();
+		if (_cacheSize != 0) {
+			spill(b);
+			b->Store("tos", value);
+			_cached = 1;
+			Trace::value(b, "$$$ RealOperandStack: push: cached value=", value);
+			return;
+		}
+
 		JB::IlValue* sp = _sp.load(b);
 		b->StoreAt(sp, value);
-		_sp.store(b,
-			b->ConvertTo(_ptype,
-				b->Add(sp, constant(b, 8)) // TODO RWY: Using magic number (sizeof int64)
-		));
+		JB::IlValue* newsp = b->ConvertTo(_ptype, b->Add(sp, constant(b, std::int64_t(SLOT_SIZE))));
+		_sp.store(b, newsp);
 
-		b->Call("print_s", 1, b->Const((void*)"$$$ RealOperandStack: pushInt64: value="));
-		b->Call("print_u", 1, value);
-		b->Call("print_s", 1, b->Const((void*)" new-sp="));
-		b->Call("print_x", 1, _sp.load(b));
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+		Trace::value(b, "$$$ RealOperandStack: push: value=", value);
+		Trace::value(b, "$$$ RealOperandStack: push: new-sp=", newsp);
 	}
 
-	/// reserve n 64bit elements on the stack. Returns a pointer to the zeroth element.
-	JB::IlValue* reserve64(JB::IlBuilder* b, RSize nelements) {
+	/// Pop a value of type T, which must fit in a slot. Only SlotInt values are cached, so
+	/// the cache is spilled first.
+	template <typename T>
+	RValue<T> pop(JB::IlBuilder* b) {
+		JB::IlType* type = slotIlType<T>(_typedict);
+		spill(b);
+
+		JB::IlValue* sp = b->Sub(_sp.load(b), constant(b, std::int64_t(SLOT_SIZE)));
+		JB::IlValue* value = b->LoadAt(_typedict->PointerTo(type), sp);
+		Checks::poison(b, sp);
+		_sp.store(b, sp);
+
+		Trace::value(b, "$$$ RealOperandStack: pop: new-sp=", sp);
+
+		return RValue<T>::pack(value);
+	}
+
+	/// Push a value of type T, which must fit in a slot. Stored as T, with no conversion.
+	template <typename T>
+	void push(JB::IlBuilder* b, RValue<T> operand) {
+		static_assert(sizeof(T) <= SLOT_SIZE, "value does not fit in a slot");
+		spill(b);
+
+		JB::IlValue* sp = _sp.load(b);
+		b->StoreAt(sp, operand.unpack());
+		JB::IlValue* newsp = b->ConvertTo(_ptype, b->Add(sp, constant(b, std::int64_t(SLOT_SIZE))));
+		_sp.store(b, newsp);
+
+		Trace::value(b, "$$$ RealOperandStack: push: new-sp=", newsp);
+	}
+
+	/// reserve n slots on the stack. Returns a pointer to the zeroth slot.
+	JB::IlValue* reserve(JB::IlBuilder* b, RSize nelements) {
+		spill(b);
 		JB::IlValue* start = _sp.load(b);
-		_sp.store(b, b->Add(start, b->Mul(b->ConstInt64(8), nelements.unpack()))); // TODO RWY: Using magic number (sizeof int64)
+		JB::IlValue* end = b->Add(start, b->Mul(b->ConstInt64(SLOT_SIZE), nelements.unpack()));
+		_sp.store(b, end);
+
+		Trace::value(b, "$$$ RealOperandStack: reserve: nelements=", nelements.unpack());
+		Trace::value(b, "$$$ RealOperandStack: reserve: new-sp=", end);
 
-		b->Call("print_s", 1, b->Const((void*)"$$$ RealOperandStack: reserve64: nelements="));
-		b->Call("print_u", 1, nelements.unpack());
-		b->Call("print_s", 1, b->Const((void*)" new-sp="));
-		b->Call("print_x", 1, _sp.load(b));
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+		return start;
+	}
+
+	/// Reserve a frame of nlocals slots, whose first nparams slots are already on the stack.
+	/// Returns a pointer to the zeroth slot.
+	JB::IlValue* reserveFrame(JB::IlBuilder* b, RSize nparams, RSize nlocals) {
+		spill(b);
+		JB::IlValue* start = b->Sub(_sp.load(b), b->Mul(b->ConstInt64(SLOT_SIZE), nparams.unpack()));
+		JB::IlValue* end = b->Add(start, b->Mul(b->ConstInt64(SLOT_SIZE), nlocals.unpack()));
+		_sp.store(b, end);
+
+		Trace::value(b, "$$$ RealOperandStack: reserveFrame: nparams=", nparams.unpack());
+		Trace::value(b, "$$$ RealOperandStack: reserveFrame: new-sp=", end);
 
 		return start;
 	}
 
+	/// Move the top depth slots up by n slots, opening a gap of n slots under them.
+	/// Returns a pointer to the gap.
+	JB::IlValue* insert(JB::IlBuilder* b, RSize depth, RSize n) {
+		spill(b);
+		JB::IlValue* sp = _sp.load(b);
+		JB::IlValue* gap = b->IndexAt(_ptype, sp, b->Sub(b->ConstInt64(0), depth.unpack()));
+
+		// Top down, so no element is overwritten before it is moved.
+		JB::IlBuilder* body = nullptr;
+		b->ForLoopUp("insert_i", &body, b->ConstInt64(1), b->Add(depth.unpack(), b->ConstInt64(1)), b->ConstInt64(1));
+		JB::IlValue* from = body->IndexAt(_ptype, sp, body->Sub(body->ConstInt64(0), body->Load("insert_i")));
+		body->StoreAt(body->IndexAt(_ptype, from, n.unpack()), body->LoadAt(_ptype, from));
+
+		_sp.store(b, b->IndexAt(_ptype, sp, n.unpack()));
+
+		Trace::value(b, "$$$ RealOperandStack: insert: gap=", gap);
+
+		return gap;
+	}
+
+	/// Move the SP to address, dropping any cached elements. Used when the frame is popped.
+	void reset(JB::IlBuilder* b, JB::IlValue* address) {
+		_sp.store(b, address);
+		_cached = 0;
+	}
+
 private:
 	JB::TypeDictionary* _typedict;
 	JB::IlType* _etype;
 	JB::IlType* _ptype;
-	RealRegister _sp;
+	InterpreterRegister _sp;
+	std::size_t _cacheSize; //< most elements cached, 0 or 1.
+	std::size_t _cached;    //< elements cached at this point of the generated code.
 };
 
 /// Purely virtual operand stack. No side effects which can be written to the.
+/// Tracks what is known about each operand, for the PURE model, and generates nothing.
+/// Operands popped from an empty stack belong to the caller, and are unknown.
 class PureOperandStack {
 public:
+	PureOperandStack() : _values(), _balanced(true) {}
+
+	void initialize() {
+		_values.clear();
+		_balanced = true;
+	}
+
+	void push(OMR_UNUSED JB::IlBuilder* b, PSlotInt value) {
+		_values.push_back(value);
+	}
+
+	PSlotInt pop(OMR_UNUSED JB::IlBuilder* b) {
+		if (_values.empty()) {
+			return PSlotInt();
+		}
+		PSlotInt value = _values.back();
+		_values.pop_back();
+		return value;
+	}
+
+	/// Push a value of type T. Only SlotInt values are tracked: any other is unknown.
+	template <typename T>
+	void push(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED PValue<T> value) {
+		static_assert(sizeof(T) <= SLOT_SIZE, "value does not fit in a slot");
+		_values.push_back(PSlotInt());
+	}
 
+	template <typename T>
+	PValue<T> pop(JB::IlBuilder* b) {
+		static_assert(sizeof(T) <= SLOT_SIZE, "value does not fit in a slot");
+		pop(b);
+		return PValue<T>();
+	}
+
+	std::size_t depth() const { return _values.size(); }
+
+	/// The i'th operand, counting from the bottom.
+	PSlotInt at(std::size_t i) const { return _values.at(i); }
+
+	/// False if paths with different depths were joined. Nothing is known about such a stack.
+	bool balanced() const { return _balanced; }
+
+	/// Join other into this stack. Returns true if this stack changed.
+	bool join(const PureOperandStack& other) {
+		if (!_balanced) {
+			return false;
+		}
+		if (!other._balanced || other._values.size() != _values.size()) {
+			_values.clear();
+			_balanced = false;
+			return true;
+		}
+		bool changed = false;
+		for (std::size_t i = 0; i < _values.size(); ++i) {
+			PSlotInt joined = _values[i].join(other._values[i]);
+			if (joined != _values[i]) {
+				_values[i] = joined;
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	void commit(OMR_UNUSED JB::IlBuilder* b) {}
+
+	void reload(OMR_UNUSED JB::IlBuilder* b) {}
+
+	void mergeInto(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED PureOperandStack& dest) {}
+
+private:
+	std::vector<PSlotInt> _values;
+	bool _balanced;
 };
 
+template <>
+inline void PureOperandStack::push<SlotInt>(JB::IlBuilder* b, PSlotInt value) {
+	push(b, value);
+}
+
+template <>
+inline PSlotInt PureOperandStack::pop<SlotInt>(JB::IlBuilder* b) {
+	return pop(b);
+}
+
 template <Mode MODE> struct OperandStackAlias;
 template <> struct OperandStackAlias<Mode::REAL> : TypeAlias<RealOperandStack> {};
 template <> struct OperandStackAlias<Mode::VIRT> : TypeAlias<VirtOperandStack> {};
@@ -1,44 +1,67 @@
 #if !defined(OMR_MODEL_OPERANDSTACKPARAMETERS_HPP_)
 #define OMR_MODEL_OPERANDSTACKPARAMETERS_HPP_
 
-// TODO RWY
-
+#include <OMR/Model.hpp>
 #include <OMR/Model/Mode.hpp>
+#include <OMR/Model/OperandStack.hpp>
+#include <OMR/Model/SlotType.hpp>
+#include <OMR/Model/Value.hpp>
 
 #include <IlBuilder.hpp>
+#include <TypeDictionary.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 
 namespace OMR {
 namespace Model {
 
+/// The arguments a caller left on the operand stack, just below the stack pointer on entry.
+/// The generated interpreter reads its arguments as locals of the frame, so only VIRT is
+/// defined.
 template <Mode M>
 class OperandStackParameters;
 
 template <>
-class OperandStackParameters<Mode::REAL> {
+class OperandStackParameters<Mode::VIRT> {
 public:
-	void initialize()
+	OperandStackParameters() : _ptype(nullptr), _addr(nullptr) {}
+
+	/// Take the address of the nparams arguments. Only valid before anything is pushed.
+	void initialize(JB::IlBuilder* b, VirtOperandStack& stack, CSize nparams) {
+		_ptype = b->typeDictionary()->PointerTo(slotType(b->typeDictionary()));
+		_addr = stack.arguments(b, nparams);
+	}
 
-	JitBuilder::IlValue* get(RBuilder* b, RSize index) {
-		return loadAt(b, indexAt(b, _addr, index));
+	KSlotInt get(JB::IlBuilder* b, CSize index) {
+		return KSlotInt::pack(b->LoadAt(_ptype, b->IndexAt(_ptype, _addr, b->Const(std::int64_t(index.unpack())))));
 	}
 
 private:
-	JitBuilder::IlValue* l
-	JitBuilder::IlValue* _addr;
+	JB::IlType* _ptype;
+	JB::IlValue* _addr;
 };
 
-template <>
-class OperandStackParameters<Mode::VIRT> {
+/// The arguments of a native signature: one SlotInt parameter each, named by name(), so they
+/// are passed in registers, as far as the ABI allows. Compile time only.
+class NativeParameters {
 public:
-	void initialize()
+	/// The most parameters a native signature takes.
+	static constexpr std::size_t MAX = 8;
 
-	JitBuilder::IlValue* get(CSize n) {
-		return Load("Param0");
+	/// The name of the parameter at index. The names outlive any method builder.
+	static const char* name(std::size_t index) {
+		static const char* const NAMES[MAX] = {
+			"arg0", "arg1", "arg2", "arg3", "arg4", "arg5", "arg6", "arg7"
+		};
+		assert(index < MAX);
+		return NAMES[index];
 	}
 
-private:
-	std::size_t _nparams;
-	JitBuilder::IlValue* _addr;
+	KSlotInt get(JB::IlBuilder* b, CSize index) {
+		return KSlotInt::pack(b->Load(name(index.unpack())));
+	}
 };
 
 }  // namespace Model
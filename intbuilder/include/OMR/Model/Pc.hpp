@@ -5,7 +5,9 @@
 #include <OMR/Model/ControlFlow.hpp>
 #include <OMR/Model/Mode.hpp>
 #include <OMR/Model/Value.hpp>
+#include <OMR/Model/Register.hpp>
 #include <OMR/Model/StaticRegister.hpp>
+#include <OMR/Model/Trace.hpp>
 #include <OMR/Model.hpp>
 #include <OMR/TypeTraits.hpp>
 #include <IlBuilder.hpp>
@@ -20,7 +22,7 @@ namespace Model {
 /// startPc
 class RealPc {
 public:
-	RealPc() : _ptype(nullptr), _address(nullptr), _base(nullptr) {}
+	RealPc() : _register(), _base(nullptr) {}
 
 	RealPc(const RealPc& other) = default;
 
@@ -28,13 +30,10 @@ public:
 
 	/// Set up the function pointer.
 	void initialize(JB::IlBuilder* b, JB::IlValue* address, RPtr<std::uint8_t> value) {
-		_ptype = b->typeDictionary()->toIlType<std::uint8_t**>();
-		_address = address;
+		_register.initialize(b, "pc", b->typeDictionary()->toIlType<std::uint8_t*>(), address);
 		_base = value.unpack();
-		b->StoreAt(_address, _base);
-		b->Call("print_s", 1, b->Const((void*)"$$$ RealPc initialize value="));
-		b->Call("print_x", 1, xload(b));
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+		_register.store(b, _base);
+		Trace::value(b, "$$$ RealPc initialize value=", _base);
 	}
 
 	RPtr<std::uint8_t> load(RBuilder* b) const {
@@ -43,16 +42,18 @@ public:
 
 	/// Load from outside a bytecode handler.
 	RPtr<std::uint8_t> xload(JB::IlBuilder* b) const {
-		JB::IlValue* value = b->LoadAt(_ptype, _address);
-		b->Call("print_s", 1, b->Const((void*)"Pc loading: value="));
-		b->Call("print_x", 1, value);
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+		JB::IlValue* value = _register.load(b);
+		Trace::value(b, "Pc loading: value=", value);
 		return RPtr<std::uint8_t>::pack(value);
 	}
 
-	void commit(JB::IlBuilder* b) {}
+	/// Point the pc at value. Only a call or a return moves to another function's code:
+	/// branches go through the ControlFlow.
+	void store(JB::IlBuilder* b, RPtr<std::uint8_t> value) { _register.store(b, value.unpack()); }
+
+	void commit(JB::IlBuilder* b) { _register.commit(b); }
 
-	void reload(JB::IlBuilder* b) {}
+	void reload(JB::IlBuilder* b) { _register.reload(b); }
 
 	void mergeInto(JB::IlBuilder* b, RealPc& dest) {}
 
@@ -69,10 +70,7 @@ public:
 				b->ConvertTo(b->Word, unpack(b)),
 				b->ConvertTo(b->Word, _base));
 
-		b->Call("print_s", 1, b->Const((void*)"Pc offset: value="));
-		b->Call("print_u", 1, value);
-		b->Call("print_s", 1, b->Const((void*)"\n"));
-
+		Trace::value(b, "Pc offset: value=", value);
 		return value;
 	}
 
@@ -80,43 +78,53 @@ public:
 	///
 
 private:
-	JB::IlType* _ptype;
-	JB::IlValue* _address;
+	InterpreterRegister _register;
 	JB::IlValue* _base;
 };
 
 /// Read-only access to the PC (aka instruction-pointer) register.
 /// For this API to work, the bytecode index must be exactly each bytecode's offset into the bytecode stream.
 /// Down the road, the mapping of bytecode-index to offset may be controlled by users.
+/// The index of the current bytecode is the builder table's cursor, since a basic block's
+/// bytecodes share one builder.
+/// The PC in memory is tracked as the offset last committed, so commit only stores when it changed.
 class VirtPc {
 public:
-	VirtPc() : _address(nullptr), _base(nullptr) {}
+	static constexpr std::size_t UNKNOWN = std::size_t(-1); //< the PC in memory is unknown.
+
+	VirtPc() : _address(nullptr), _base(nullptr), _builders(nullptr), _committed(UNKNOWN) {}
 
-	void initialize(JB::IlBuilder* b, JB::IlValue* address, CPtr<std::uint8_t> value) {
-		b->Call("print_s", 1, b->Const((void*)"$$$ VirtPc initialize value="));
-		b->Call("print_x", 1, value.toIl(b));
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+	void initialize(JB::IlBuilder* b, JB::IlValue* address, CPtr<std::uint8_t> value, JB::BytecodeBuilderTable* builders) {
+		Trace::staticValue(b, "$$$ VirtPc initialize value=", std::uintptr_t(value.unpack()));
 		_address = address;
 		_base = value.unpack();
+		_builders = builders;
+		_committed = UNKNOWN;
 	}
 
 	CPtr<std::uint8_t> load(CBuilder* b) const {
-		b->Call("print_s", 1, b->Const((void*)"$$$ VirtPc: load value="));
-		b->Call("print_x", 1, constant(b, unpack(b)));
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+		Trace::staticValue(b, "$$$ VirtPc: load value=", std::uintptr_t(unpack(b)));
 		return CPtr<std::uint8_t>::pack(unpack(b));
 	}
 
-	void commit(CBuilder* b) {
-		b->Call("print_s", 1, b->Const((void*)"$$$ VirtPc: commit: value="));
-		b->Call("print_x", 1, load(b).toIl(b));
-		b->Call("print_s", 1, b->Const((void*)"\n"));
-		b->StoreAt(_address, constant(b, unpack(b)));
+	void commit(JB::IlBuilder* b) {
+		std::size_t offset = _builders->cursor();
+		if (_committed == offset) {
+			return;
+		}
+		Trace::staticValue(b, "$$$ VirtPc: commit: value=", std::uintptr_t(_base + offset));
+		b->StoreAt(_address, constant(b, _base + offset));
+		_committed = offset;
 	}
 
 	void reload(OMR_UNUSED JB::IlBuilder* b) {}
 
-	void mergeInto(OMR_UNUSED JB::IlBuilder* b, VirtPc& dest) {}
+	/// If dest assumes a PC is in memory, make it so on this edge.
+	void mergeInto(JB::IlBuilder* b, VirtPc& dest) {
+		if (dest._committed != UNKNOWN && dest._committed != _committed) {
+			b->StoreAt(_address, constant(b, _base + dest._committed));
+		}
+	}
 
 	/// @group Unsafe / non-generic functionality.
 	/// @{
@@ -125,10 +133,10 @@ public:
 	std::uint8_t* base() const { return _base; }
 
 	/// Obtain the compile-time value of the PC. Internal API.
-	/// The PC is derived from the current bytecode builder.
+	/// The PC is derived from the bytecode being compiled.
 	std::uint8_t* unpack(CBuilder* b) const { return _base + offset(b); }
 
-	std::size_t offset(CBuilder* b) const { return b->bcIndex(); }
+	std::size_t offset(OMR_UNUSED CBuilder* b) const { return _builders->cursor(); }
 
 	/// @}
 	///
@@ -136,6 +144,8 @@ public:
 private:
 	JB::IlValue* _address;
 	std::uint8_t* _base;
+	JB::BytecodeBuilderTable* _builders;
+	std::size_t _committed; //< offset of the PC last committed to memory, or UNKNOWN.
 };
 
 template <Mode M> struct PcAlias;
@@ -2,11 +2,25 @@
 #define OMR_MODEL_REGISTER_HPP_
 
 #include <OMR/Model/Mode.hpp>
+#include <OMR/Model/Slot.hpp>
 #include <OMR/TypeTraits.hpp>
 #include <OMR/Model.hpp>
 #include <IlBuilder.hpp>
 #include <TypeDictionary.hpp>
 
+/// @group Interpreter register policy.
+/// Where the generated interpreter keeps its sp and pc while it runs. Select at build time by
+/// defining OMR_MODEL_CACHE_REGISTERS. Defaults to 1: kept in locals, see LocalRegister.
+/// Set to 0 to read and write the Interpreter's fields on every use, see RealRegister.
+/// @{
+
+#if !defined(OMR_MODEL_CACHE_REGISTERS)
+#define OMR_MODEL_CACHE_REGISTERS 1
+#endif
+
+/// @}
+///
+
 namespace OMR {
 
 namespace JB = OMR::JitBuilder;
@@ -18,7 +32,7 @@ class RealRegister {
 public:
 	RealRegister() : _type(nullptr), _ptype(nullptr), _address(nullptr) {}
 
-	JB::IlValue* load(JB::IlBuilder* b) {
+	JB::IlValue* load(JB::IlBuilder* b) const {
 		return b->LoadAt(_ptype, _address);
 	}
 
@@ -34,6 +48,11 @@ public:
 		// no initial load.
 	}
 
+	/// Same as initialize(b, type, address). The name is only used by LocalRegister.
+	void initialize(JB::IlBuilder* b, OMR_UNUSED const char* name, JB::IlType* type, JB::IlValue* address) {
+		initialize(b, type, address);
+	}
+
 	void commit(JB::IlBuilder* b) {}
 
 	void reload(JB::IlBuilder* b) {}
@@ -46,35 +65,104 @@ private:
 	JB::IlValue* _address;
 };
 
+/// A register held in a named local of the generated function, for the whole function. In
+/// the generated interpreter the local lives across the dispatch loop, so the compiler can
+/// keep it in a machine register. Memory is only read by reload, and only written by commit:
+/// commit before anything that reads the register's memory, such as a helper or a return to
+/// the host, and reload after anything that writes it.
+///
+/// Copies, and any other LocalRegister with the same name, are the same register.
+class LocalRegister {
+public:
+	LocalRegister() : _name(nullptr), _type(nullptr), _ptype(nullptr), _address(nullptr) {}
+
+	JB::IlValue* load(JB::IlBuilder* b) const {
+		return b->Load(_name);
+	}
+
+	void store(JB::IlBuilder* b, JB::IlValue* value) {
+		b->Store(_name, b->ConvertTo(_type, value));
+	}
+
+	/// Bind the register to its local and its memory. Emits nothing: the value is undefined
+	/// until it is stored or reloaded.
+	void initialize(JB::IlBuilder* b, const char* name, JB::IlType* type, JB::IlValue* address) {
+		_name = name;
+		_type = type;
+		_ptype = b->typeDictionary()->PointerTo(_type);
+		_address = b->ConvertTo(_ptype, address);
+	}
+
+	void commit(JB::IlBuilder* b) {
+		b->StoreAt(_address, b->Load(_name));
+	}
+
+	void reload(JB::IlBuilder* b) {
+		b->Store(_name, b->LoadAt(_ptype, _address));
+	}
+
+	void mergeInto(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED LocalRegister& dest) {}
+
+private:
+	const char* _name;
+	JB::IlType* _type;
+	JB::IlType* _ptype;
+	JB::IlValue* _address;
+};
+
+#if OMR_MODEL_CACHE_REGISTERS
+using InterpreterRegister = LocalRegister;
+#else
+using InterpreterRegister = RealRegister;
+#endif
+
+/// A register buffered in an IlValue. Memory is only written by commit, and only if the
+/// register was stored to since it was last loaded or committed. Its value is always IL,
+/// never a known constant.
 class VirtRegister {
 public:
-	VirtRegister() : _type(nullptr), _ptype(nullptr), _address(nullptr), _value(nullptr) {}
+	VirtRegister() : _type(nullptr), _ptype(nullptr), _address(nullptr), _slot() {}
 
 	VirtRegister(const VirtRegister& other) = default;
 
-	JB::IlValue* load(JB::IlBuilder* b) { return _value; }
+	JB::IlValue* load(JB::IlBuilder* b) { return _slot.value.unpack(); }
 
-	void store(JB::IlBuilder* b, JB::IlValue* value) { _value = value; }
+	void store(JB::IlBuilder* b, JB::IlValue* value) { _slot = Slot::dirty(KSlotInt::pack(value)); }
 
 	void initialize(JB::IlBuilder* b, JB::IlType* type, JB::IlValue* address) {
 		_type = type;
 		_ptype = b->typeDictionary()->PointerTo(type);
 		_address = b->ConvertTo(_ptype, address);
 
-		_value = b->LoadAt(_ptype, _address);
+		_slot = Slot::clean(KSlotInt::pack(b->LoadAt(_ptype, _address)));
+	}
+
+	void commit(JB::IlBuilder* b) {
+		if (_slot.isDirty()) {
+			b->StoreAt(_address, _slot.value.unpack());
+			_slot.state = Slot::State::CLEAN;
+		}
 	}
 
-	void commit(JB::IlBuilder* b) { b->StoreAt(_address, _value); }
+	void reload(JB::IlBuilder* b) {
+		b->StoreOver(_slot.value.unpack(), b->LoadAt(_ptype, _address));
+		_slot.state = Slot::State::CLEAN;
+	}
 
-	void reload(JB::IlBuilder* b) { b->StoreOver(_value, b->LoadAt(_ptype, _address)); }
+	void mergeInto(JB::IlBuilder* b, VirtRegister& dest) {
+		if (_slot.needsEdgeStore(dest._slot)) {
+			b->StoreAt(_address, _slot.value.unpack());
+		}
+		b->StoreOver(dest._slot.value.unpack(), _slot.value.unpack());
+	}
 
-	void mergeInto(JB::IlBuilder* b, VirtRegister& dest) { b->StoreOver(dest._value, _value); }
+	bool isDirty() const { return _slot.isDirty(); }
 
 private:
 	JB::IlType* _type;
 	JB::IlType* _ptype;
 	JB::IlValue* _address;
-	JB::IlValue* _value;
+	Slot _slot;
 };
 
 class PureRegister {
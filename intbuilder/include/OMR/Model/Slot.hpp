@@ -0,0 +1,142 @@
+#if !defined(OMR_MODEL_SLOT_HPP_)
+#define OMR_MODEL_SLOT_HPP_
+
+#include <OMR/Model/Value.hpp>
+
+#include <IlBuilder.hpp>
+#include <IlType.hpp>
+#include <TypeDictionary.hpp>
+
+#include <cassert>
+#include <cstdint>
+
+namespace OMR {
+namespace Model {
+
+namespace JB = OMR::JitBuilder;
+
+/// The compile-time value of one slot of VM memory, such as a local or a stack slot.
+///
+/// An IN_MEMORY slot has no value yet: it is loaded on first use, in the builder that needs it.
+/// A CLEAN slot's value is known to be in memory, so committing it is a no-op.
+/// A DIRTY slot has been written since it was last loaded or committed.
+///
+/// A slot's value may be a known constant, which has no IL until it is stored or used.
+/// Known values only live within a basic block: materialize() gives them IL before control
+/// leaves the block, since every value in a block's entry state is merged into with StoreOver.
+///
+/// When a slot is merged into a block's entry state, the entry state's assumption must
+/// hold on every incoming edge: if the destination is not DIRTY and the source is, the
+/// source's value is stored to memory on that edge. If the destination has a value and
+/// the source does not, the value is loaded on that edge.
+///
+/// A slot holds a value of any type that fits in it. type is the IL type of a value that
+/// is not a SlotInt, such as a double, whose IL is kept as it is rather than converted to
+/// an integer. Only SlotInt values can be known constants.
+struct Slot {
+	enum class State : std::uint8_t { IN_MEMORY, CLEAN, DIRTY };
+
+	static Slot inMemory() { return Slot(KSlotInt(), State::IN_MEMORY); }
+
+	static Slot clean(KSlotInt value, JB::IlType* type = nullptr) { return Slot(value, State::CLEAN, type); }
+
+	static Slot dirty(KSlotInt value, JB::IlType* type = nullptr) { return Slot(value, State::DIRTY, type); }
+
+	/// The slot representation of a value of type T: its IL, unless T is SlotInt.
+	template <typename T>
+	static KSlotInt encode(JB::IlBuilder* b, KValue<T> value) {
+		return KSlotInt::pack(value.toIl(b));
+	}
+
+	/// The value of type T held in a slot. See encode().
+	template <typename T>
+	static KValue<T> decode(KSlotInt value) {
+		assert(!value.isKnown());
+		return KValue<T>::pack(value.unpack());
+	}
+
+	Slot() : value(), state(State::IN_MEMORY), type(nullptr) {}
+
+	Slot(KSlotInt value, State state, JB::IlType* type = nullptr) : value(value), state(state), type(type) {}
+
+	bool isDirty() const { return state == State::DIRTY; }
+
+	bool isInMemory() const { return state == State::IN_MEMORY; }
+
+	bool isKnown() const { return !isInMemory() && value.isKnown(); }
+
+	/// True if merging this slot into dest must store the value on the edge.
+	bool needsEdgeStore(const Slot& dest) const {
+		return isDirty() && !dest.isDirty();
+	}
+
+	/// True if merging this slot into dest must load the value on the edge.
+	bool needsEdgeLoad(const Slot& dest) const {
+		return isInMemory() && !dest.isInMemory();
+	}
+
+	/// Load the value if it is still in memory, as a value of type: nullptr for SlotInt, or
+	/// ptype's element type. Returns the value.
+	KSlotInt load(JB::IlBuilder* b, JB::IlType* ptype, JB::IlValue* address, JB::IlType* type = nullptr) {
+		if (isInMemory()) {
+			value = KSlotInt::pack(b->LoadAt(ptype, address));
+			state = State::CLEAN;
+			this->type = type;
+		}
+		return value;
+	}
+
+	/// The slot is known to hold value. Memory is only known to hold it if it is not dirty.
+	void assume(SlotInt known) {
+		value = KSlotInt::known(known);
+		type = nullptr;
+		if (isInMemory()) {
+			state = State::CLEAN;
+		}
+	}
+
+	/// Give a known value its IL, in b.
+	void materialize(JB::IlBuilder* b) {
+		if (isKnown()) {
+			value = KSlotInt::pack(value.toIl(b));
+		}
+	}
+
+	/// Merge this slot into dest, on the edge b. address is the slot's memory, and ptype the
+	/// type of a pointer to a SlotInt slot.
+	void mergeInto(JB::IlBuilder* b, const Slot& dest, JB::IlType* ptype, JB::IlValue* address) const {
+		assert(!dest.isKnown()); // entry states are materialized.
+		assert(isInMemory() || dest.isInMemory() || type == dest.type);
+		if (needsEdgeStore(dest)) {
+			b->StoreAt(address, value.toIl(b));
+		}
+		if (dest.isInMemory()) {
+			return;
+		}
+		if (needsEdgeLoad(dest)) {
+			JB::IlType* loadType = dest.type != nullptr ? b->typeDictionary()->PointerTo(dest.type) : ptype;
+			b->StoreOver(dest.value.unpack(), b->LoadAt(loadType, address));
+		} else {
+			b->StoreOver(dest.value.unpack(), value.toIl(b));
+		}
+	}
+
+	KSlotInt value;
+	State state;
+	JB::IlType* type; //< nullptr for SlotInt.
+};
+
+template <>
+inline KSlotInt Slot::encode<SlotInt>(OMR_UNUSED JB::IlBuilder* b, KSlotInt value) {
+	return value;
+}
+
+template <>
+inline KSlotInt Slot::decode<SlotInt>(KSlotInt value) {
+	return value;
+}
+
+}  // namespace Model
+}  // namespace OMR
+
+#endif // OMR_MODEL_SLOT_HPP_
@@ -0,0 +1,80 @@
+#if !defined(OMR_MODEL_SLOTTYPE_HPP_)
+#define OMR_MODEL_SLOTTYPE_HPP_
+
+#include <OMR/Model.hpp>
+
+#include <IlType.hpp>
+#include <TypeDictionary.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/// @group Slot width.
+/// The width, in bytes, of one element of an operand stack or operand array. Every element
+/// takes one slot, whatever its type, so a value must fit in a slot to be pushed. Select at
+/// build time by defining OMR_MODEL_SLOT_SIZE, to 4 or 8. Defaults to 8. The untyped
+/// operations, such as push and pop without a type, work on SlotInt.
+/// @{
+
+#if !defined(OMR_MODEL_SLOT_SIZE)
+#define OMR_MODEL_SLOT_SIZE 8
+#endif
+
+/// @}
+///
+
+namespace OMR {
+namespace Model {
+
+namespace JB = OMR::JitBuilder;
+
+constexpr std::size_t SLOT_SIZE = OMR_MODEL_SLOT_SIZE;
+
+static_assert(SLOT_SIZE == 4 || SLOT_SIZE == 8, "OMR_MODEL_SLOT_SIZE must be 4 or 8");
+
+/// The integer as wide as a slot. The operand stacks and arrays hold SlotInts unless told
+/// otherwise: it is the type a VM's operands and locals have, and the only type whose
+/// values can be known constants.
+using SlotInt = std::conditional<SLOT_SIZE == 8, std::int64_t, std::int32_t>::type;
+
+/// The IL type of a value of type T held in a slot. Defined for the types the operand
+/// stack and arrays can hold: int32, int64, float, double and pointers.
+template <typename T> struct SlotIlType;
+
+template <> struct SlotIlType<std::int32_t> {
+	static JB::IlType* get(JB::TypeDictionary* t) { return t->Int32; }
+};
+
+template <> struct SlotIlType<std::int64_t> {
+	static JB::IlType* get(JB::TypeDictionary* t) { return t->Int64; }
+};
+
+template <> struct SlotIlType<float> {
+	static JB::IlType* get(JB::TypeDictionary* t) { return t->Float; }
+};
+
+template <> struct SlotIlType<double> {
+	static JB::IlType* get(JB::TypeDictionary* t) { return t->Double; }
+};
+
+template <typename T> struct SlotIlType<T*> {
+	static JB::IlType* get(JB::TypeDictionary* t) { return t->Address; }
+};
+
+/// The IL type of T, which must fit in a slot.
+template <typename T>
+JB::IlType* slotIlType(JB::TypeDictionary* t) {
+	static_assert(sizeof(T) <= SLOT_SIZE, "value does not fit in a slot");
+	return SlotIlType<T>::get(t);
+}
+
+/// The IL type of SlotInt: the element type of operand stacks and arrays.
+inline JB::IlType* slotType(JB::TypeDictionary* t) {
+	return SLOT_SIZE == 8 ? t->Int64 : t->Int32;
+}
+
+}  // namespace Model
+}  // namespace OMR
+
+#endif // OMR_MODEL_SLOTTYPE_HPP_
@@ -3,7 +3,9 @@
 
 #include <OMR/Model.hpp>
 #include <OMR/Model/Mode.hpp>
+#include <OMR/Model/Trace.hpp>
 
+#include <cassert>
 #include <cstdint>
 
 namespace OMR {
@@ -42,21 +44,14 @@ public:
 
 	RValue<T> load(OMR_UNUSED JB::IlBuilder* b) {
 		reload(b);
-
-		b->Call("print_s", 1, b->Const((void*)"StaticRegister<REAL>: LOAD value="));
-		b->Call("print_x", 1, _value);
-		b->Call("print_s", 1, b->Const((void*)"\n"));
-
+		Trace::value(b, "StaticRegister<REAL>: LOAD value=", _value);
 		return RValue<T>::pack(_value);
 	};
 
 	void store(JB::IlBuilder* b, RValue<T> value) {
 		_value = value.unpack();
 		b->StoreAt(_address, _value);
-
-		b->Call("print_s", 1, b->Const((void*)"StaticRegister<REAL>: STORE value="));
-		b->Call("print_x", 1, _value);
-		b->Call("print_s", 1, b->Const((void*)"\n"));
+		Trace::value(b, "StaticRegister<REAL>: STORE value=", _value);
 	}
 
 	void commit(JB::IlBuilder* b) {
@@ -83,10 +78,12 @@ private:
 	JB::IlValue* _value;
 };
 
+/// The value is known at compile time. Memory is only written by commit, and only if
+/// the value changed since it was last committed.
 template <typename T>
 class StaticRegister<Mode::VIRT, T> {
 public:
-	StaticRegister() : _address(nullptr) {}
+	StaticRegister() : _address(nullptr), _value(), _dirty(true) {}
 
 	StaticRegister(const StaticRegister<Mode::VIRT, T>& other) = default;
 
@@ -95,16 +92,24 @@ public:
 	}
 
 	void store(OMR_UNUSED JB::IlBuilder* b, CValue<T> value) {
-		_value = value.unpack();
+		if (_dirty || _value != value.unpack()) {
+			_value = value.unpack();
+			_dirty = true;
+		}
 	}
 
+	/// The initial value is not assumed to be in memory.
 	void initialize(OMR_UNUSED JB::IlBuilder* b, JB::IlValue* address, CValue<T> value) {
 		_address = address;
-		store(b, value);
+		_value = value.unpack();
+		_dirty = true;
 	}
 
 	void commit(JB::IlBuilder* b) {
-		b->StoreAt(_address, constant(b, _value));
+		if (_dirty) {
+			b->StoreAt(_address, constant(b, _value));
+			_dirty = false;
+		}
 	}
 
 	void reload(OMR_UNUSED JB::IlBuilder* b) {}
@@ -112,16 +117,21 @@ public:
 	// Convert to internal representation.
 	T unpack() const { return _value; }
 
-	void mergeInto(JB::IlBuilder* b, StaticRegister& reg) {
-		/// RWY TODO: There is actually no state to merge here. The register's value is
-		/// static, which means that the destination should have it's own value.
-		/// there is nothing left to do.
-		/// The todo is, is this actually true?
+	bool isDirty() const { return _dirty; }
+
+	void mergeInto(JB::IlBuilder* b, StaticRegister& dest) {
+		/// The register's value is static, so the destination already has its own value.
+		/// All that is left is to keep memory in sync, if the destination assumes it is.
+		assert(_value == dest._value);
+		if (_dirty && !dest._dirty) {
+			b->StoreAt(_address, constant(b, _value));
+		}
 	}
 
 private:
 	JB::IlValue* _address;
 	T _value;
+	bool _dirty;
 };
 
 template <typename T>
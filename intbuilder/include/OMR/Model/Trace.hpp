@@ -0,0 +1,187 @@
+#if !defined(OMR_MODEL_TRACE_HPP_)
+#define OMR_MODEL_TRACE_HPP_
+
+#include <OMR/Model.hpp>
+
+#include <IlBuilder.hpp>
+#include <TypeDictionary.hpp>
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/// @group IL trace policies.
+/// Select one at build time by defining OMR_MODEL_TRACE. Defaults to NONE.
+/// @{
+
+#define OMR_MODEL_TRACE_NONE  0 // No trace IL is generated.
+#define OMR_MODEL_TRACE_PRINT 1 // Generated code calls the print_* / dbg_msg helpers.
+#define OMR_MODEL_TRACE_RING  2 // Generated code writes binary records into a TraceBuffer.
+
+#if !defined(OMR_MODEL_TRACE)
+#define OMR_MODEL_TRACE OMR_MODEL_TRACE_NONE
+#endif
+
+/// @}
+///
+
+namespace OMR {
+namespace Model {
+
+/// One fixed-size binary trace record.
+/// The label is a string literal owned by the IL generator, never copied.
+struct TraceRecord {
+	const char* label;
+	std::uint64_t value;
+};
+
+/// A ring of trace records, written directly by generated code.
+/// head counts every record ever written. The newest record is at (head - 1) & MASK.
+struct TraceBuffer {
+	static constexpr std::size_t CAPACITY = 1024; //< in records, must be a power of two.
+	static constexpr std::size_t MASK = CAPACITY - 1;
+
+	TraceBuffer() : head(0), records() {}
+
+	/// Number of records still held in the ring.
+	std::size_t size() const { return head < CAPACITY ? head : CAPACITY; }
+
+	/// The i'th oldest record still held in the ring.
+	const TraceRecord& at(std::size_t i) const {
+		return records[(head - size() + i) & MASK];
+	}
+
+	void clear() { head = 0; }
+
+	void dump(std::FILE* out) const {
+		for (std::size_t i = 0; i < size(); ++i) {
+			std::fprintf(out, "%s 0x%" PRIx64 "\n", at(i).label, at(i).value);
+		}
+	}
+
+	std::uint64_t head;
+	TraceRecord records[CAPACITY];
+};
+
+/// Define the TraceBuffer and TraceRecord structs, for use by generated code.
+inline void defineTraceTypes(JB::TypeDictionary* t) {
+	t->DefineStruct("TraceRecord");
+	t->DefineField("TraceRecord", "label", t->Address, offsetof(TraceRecord, label));
+	t->DefineField("TraceRecord", "value", t->Int64,   offsetof(TraceRecord, value));
+	t->CloseStruct("TraceRecord");
+
+	t->DefineStruct("TraceBuffer");
+	t->DefineField("TraceBuffer", "head",    t->Int64,  offsetof(TraceBuffer, head));
+	t->DefineField("TraceBuffer", "records", t->NoType, offsetof(TraceBuffer, records));
+	t->CloseStruct("TraceBuffer");
+}
+
+/// Generates no trace IL at all.
+struct NoTrace {
+	static constexpr bool ENABLED = false;
+	static constexpr bool STDIO = false;
+
+	static void initialize(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED JB::IlValue* buffer) {}
+
+	static void message(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED const char* msg) {}
+
+	static void location(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED const char* file, OMR_UNUSED std::size_t line,
+		OMR_UNUSED const char* function, OMR_UNUSED const char* msg) {}
+
+	static void value(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED const char* label, OMR_UNUSED JB::IlValue* value) {}
+
+	static void staticValue(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED const char* label, OMR_UNUSED std::uint64_t value) {}
+};
+
+/// Generated code prints through the print_s, print_x and dbg_msg helpers.
+/// Every trace point is a call into stdio.
+struct PrintTrace {
+	static constexpr bool ENABLED = true;
+	static constexpr bool STDIO = true;
+
+	static void initialize(OMR_UNUSED JB::IlBuilder* b, OMR_UNUSED JB::IlValue* buffer) {}
+
+	static void message(JB::IlBuilder* b, const char* msg) {
+		b->Call("print_s", 1, b->Const((void*)msg));
+	}
+
+	static void location(JB::IlBuilder* b, const char* file, std::size_t line, const char* function, const char* msg) {
+		b->Call("dbg_msg", 4,
+			b->Const((void*)file),
+			b->Const((std::int64_t)line),
+			b->Const((void*)function),
+			b->Const((void*)msg)
+		);
+	}
+
+	static void value(JB::IlBuilder* b, const char* label, JB::IlValue* value) {
+		b->Call("print_s", 1, b->Const((void*)label));
+		b->Call("print_x", 1, value);
+		b->Call("print_s", 1, b->Const((void*)"\n"));
+	}
+
+	static void staticValue(JB::IlBuilder* b, const char* label, std::uint64_t value) {
+		PrintTrace::value(b, label, b->Const((std::int64_t)value));
+	}
+};
+
+/// Generated code appends TraceRecords to a TraceBuffer, without calling out.
+/// The buffer's address is kept in the "trace_buffer" local, set by initialize().
+struct RingTrace {
+	static constexpr bool ENABLED = true;
+	static constexpr bool STDIO = false;
+
+	/// Must be called once, at function entry, before any other trace point.
+	static void initialize(JB::IlBuilder* b, JB::IlValue* buffer) {
+		JB::TypeDictionary* t = b->typeDictionary();
+		b->Store("trace_buffer",
+			b->ConvertTo(t->PointerTo(t->LookupStruct("TraceBuffer")), buffer));
+	}
+
+	static void message(JB::IlBuilder* b, const char* msg) {
+		record(b, msg, b->ConstInt64(0));
+	}
+
+	static void location(JB::IlBuilder* b, OMR_UNUSED const char* file, std::size_t line,
+		OMR_UNUSED const char* function, const char* msg) {
+		record(b, msg, b->ConstInt64(std::int64_t(line)));
+	}
+
+	static void value(JB::IlBuilder* b, const char* label, JB::IlValue* value) {
+		record(b, label, b->ConvertTo(b->typeDictionary()->Int64, value));
+	}
+
+	static void staticValue(JB::IlBuilder* b, const char* label, std::uint64_t value) {
+		record(b, label, b->ConstInt64(std::int64_t(value)));
+	}
+
+private:
+	static void record(JB::IlBuilder* b, const char* label, JB::IlValue* value) {
+		JB::TypeDictionary* t = b->typeDictionary();
+		JB::IlType* precord = t->PointerTo(t->LookupStruct("TraceRecord"));
+
+		JB::IlValue* buffer = b->Load("trace_buffer");
+		JB::IlValue* head = b->LoadIndirect("TraceBuffer", "head", buffer);
+		JB::IlValue* slot = b->And(head, b->ConstInt64(TraceBuffer::MASK));
+		JB::IlValue* records = b->ConvertTo(precord, b->StructFieldInstanceAddress("TraceBuffer", "records", buffer));
+		JB::IlValue* record = b->IndexAt(precord, records, slot);
+
+		b->StoreIndirect("TraceRecord", "label", record, b->Const((void*)label));
+		b->StoreIndirect("TraceRecord", "value", record, value);
+		b->StoreIndirect("TraceBuffer", "head", buffer, b->Add(head, b->ConstInt64(1)));
+	}
+};
+
+#if OMR_MODEL_TRACE == OMR_MODEL_TRACE_RING
+using Trace = RingTrace;
+#elif OMR_MODEL_TRACE == OMR_MODEL_TRACE_PRINT
+using Trace = PrintTrace;
+#else
+using Trace = NoTrace;
+#endif
+
+}  // namespace Model
+}  // namespace OMR
+
+#endif // OMR_MODEL_TRACE_HPP_
@@ -3,11 +3,13 @@
 
 #include <OMR/Model.hpp>
 #include <OMR/Model/Mode.hpp>
+#include <OMR/Model/SlotType.hpp>
 #include <OMR/TypeTraits.hpp>
 
 #include <IlBuilder.hpp>
 #include <IlValue.hpp>
 
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
 
@@ -130,6 +132,52 @@ private:
 	T _value;
 };
 
+/// An abstract value, for the PURE model, which generates no code. Either known at compile
+/// time, or unknown: some value only the running code has. Values form a lattice, whose
+/// join() keeps a value known only if both sides agree on it.
+template <typename T>
+class Value<Mode::PURE, T> {
+public:
+	using Type = T;
+
+	/// A known value.
+	static Value<Mode::PURE, T> pack(T value) { return Value<Mode::PURE, T>(true, value); }
+
+	/// An unknown value.
+	Value() : _known(false), _value() {}
+
+	/// Construct a known value.
+	Value(OMR_UNUSED JB::IlBuilder* b, T value) : Value(true, value) {}
+
+	bool isKnown() const noexcept { return _known; }
+
+	/// The known value. Only valid if isKnown().
+	T unpack() const noexcept {
+		assert(_known);
+		return _value;
+	}
+
+	/// Convert to JitBuilder IL, for tracing. Only valid if isKnown().
+	JB::IlValue* toIl(JB::IlBuilder* b) const { return constant(b, unpack()); }
+
+	/// The least upper bound of this and other.
+	Value<Mode::PURE, T> join(const Value<Mode::PURE, T>& other) const {
+		return (_known && other._known && _value == other._value) ? *this : Value<Mode::PURE, T>();
+	}
+
+	bool operator==(const Value<Mode::PURE, T>& other) const {
+		return _known == other._known && (!_known || _value == other._value);
+	}
+
+	bool operator!=(const Value<Mode::PURE, T>& other) const { return !(*this == other); }
+
+private:
+	Value(bool known, T value) : _known(known), _value(value) {}
+
+	bool _known;
+	T _value;
+};
+
 /// @group Modal value types.
 /// @{
 
@@ -208,6 +256,89 @@ using CPtrDiff = CValue<std::ptrdiff_t>;
 /// @}
 ///
 
+/// Pure value, aka "PURE" value.
+///
+template <typename T>
+using PValue = Value<Mode::PURE, T>;
+
+/// @group Collection of pure value types.
+/// @{
+
+template <typename T> using PPtr = PValue<T*>;
+using PSize = PValue<std::size_t>;
+using PInt64 = PValue<std::int64_t>;
+using PUInt64 = PValue<std::uint64_t>;
+
+/// @}
+///
+
+/// Known value, aka "K" value. A VIRT model's view of a VM value, such as an operand or a
+/// local: either a constant known at compile time, or the IL of a value only known when the
+/// code runs. A known constant has no IL until some builder needs it, so folding it into
+/// another constant emits nothing.
+///
+template <typename T>
+class KValue {
+public:
+	using Type = T;
+
+	/// A value only known at run time.
+	static KValue<T> pack(JB::IlValue* value) { return KValue<T>(value, false, T()); }
+
+	/// A value known at compile time.
+	static KValue<T> known(T value) { return KValue<T>(nullptr, true, value); }
+
+	KValue() : _il(nullptr), _known(false), _value() {}
+
+	/// A compile-time value is known.
+	KValue(CValue<T> value) : KValue(nullptr, true, value.unpack()) {}
+
+	bool isKnown() const noexcept { return _known; }
+
+	/// The known value. Only valid if isKnown().
+	T value() const noexcept { return _value; }
+
+	/// Convert to JitBuilder IL. A known value's IL is a constant, made in b.
+	JB::IlValue* toIl(JB::IlBuilder* b) const { return _known ? constant(b, _value) : _il; }
+
+	/// The IL of a value only known at run time, or nullptr for a known value.
+	JB::IlValue* unpack() const noexcept { return _il; }
+
+private:
+	KValue(JB::IlValue* il, bool known, T value) : _il(il), _known(known), _value(value) {}
+
+	JB::IlValue* _il;
+	bool _known;
+	T _value;
+};
+
+using KInt64 = KValue<std::int64_t>;
+
+/// @group Values as wide as a slot. See SlotInt.
+/// @{
+
+using RSlotInt = RValue<SlotInt>;
+using CSlotInt = CValue<SlotInt>;
+using KSlotInt = KValue<SlotInt>;
+using PSlotInt = PValue<SlotInt>;
+
+/// @}
+///
+
+/// The value of a VM operand or local: run-time IL in REAL mode, a known value in VIRT
+/// mode, so the compiler can fold what it knows, and an abstract value in PURE mode.
+/// @{
+
+template <Mode M> struct OperandAlias;
+template <> struct OperandAlias<Mode::REAL> : TypeAlias<RSlotInt> {};
+template <> struct OperandAlias<Mode::VIRT> : TypeAlias<KSlotInt> {};
+template <> struct OperandAlias<Mode::PURE> : TypeAlias<PSlotInt> {};
+
+template <Mode M> using Operand = typename OperandAlias<M>::Type;
+
+/// @}
+///
+
 }  // namespace ValueTypes
 }  // namespace Model
 }  // namespace OMR
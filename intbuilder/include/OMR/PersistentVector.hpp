@@ -0,0 +1,179 @@
+#if !defined(OMR_PERSISTENTVECTOR_HPP_)
+#define OMR_PERSISTENTVECTOR_HPP_
+
+#include <OMR/Arena.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+namespace OMR {
+
+/// A vector with constant-time copies, by structural sharing.
+///
+/// Elements live in fixed-size chunks, reached through a directory of chunk pointers.
+/// Each chunk and directory is stamped with the ownership token of the vector that
+/// allocated it, and may only be written in place by that vector. Copying a vector
+/// shares the directory and gives both vectors fresh tokens, so everything allocated
+/// before the copy is immutable, and the first write to a chunk copies just that chunk
+/// (and the directory, once).
+///
+/// All memory comes from an Arena, and is only freed with it. T must be trivially copyable.
+template <typename T, std::size_t CHUNK = 16>
+class PersistentVector {
+public:
+	PersistentVector() : _arena(nullptr), _dir(nullptr), _size(0), _owner(newOwner()) {}
+
+	explicit PersistentVector(Arena* arena) : _arena(arena), _dir(nullptr), _size(0), _owner(newOwner()) {}
+
+	PersistentVector(std::size_t n, const T& value, Arena* arena) : PersistentVector(arena) {
+		assign(n, value);
+	}
+
+	PersistentVector(const PersistentVector& other)
+		: _arena(other._arena), _dir(other._dir), _size(other._size), _owner(newOwner()) {
+		other._owner = newOwner();
+	}
+
+	PersistentVector& operator=(const PersistentVector& other) {
+		if (this != &other) {
+			_arena = other._arena;
+			_dir = other._dir;
+			_size = other._size;
+			_owner = newOwner();
+			other._owner = newOwner();
+		}
+		return *this;
+	}
+
+	std::size_t size() const { return _size; }
+
+	bool empty() const { return _size == 0; }
+
+	const T& operator[](std::size_t i) const {
+		return _dir->chunks[i / CHUNK]->items[i % CHUNK];
+	}
+
+	const T& at(std::size_t i) const {
+		assert(i < _size);
+		return (*this)[i];
+	}
+
+	const T& back() const { return at(_size - 1); }
+
+	/// Writable access to element i. Copies the chunk holding it, if the chunk is shared.
+	T& mutableAt(std::size_t i) {
+		assert(i < _size);
+		return writableChunk(i / CHUNK)->items[i % CHUNK];
+	}
+
+	void set(std::size_t i, const T& value) { mutableAt(i) = value; }
+
+	void push_back(const T& value) {
+		std::size_t i = _size;
+		reserveChunks(i / CHUNK + 1);
+		_size += 1;
+		mutableAt(i) = value;
+	}
+
+	void pop_back() {
+		assert(_size > 0);
+		_size -= 1;
+	}
+
+	void assign(std::size_t n, const T& value) {
+		clear();
+		for (std::size_t i = 0; i < n; ++i) {
+			push_back(value);
+		}
+	}
+
+	void clear() { _size = 0; }
+
+private:
+	struct Chunk {
+		std::uint64_t owner;
+		T items[CHUNK];
+	};
+
+	struct Directory {
+		std::uint64_t owner;
+		std::size_t count;    //< number of chunk pointers in use.
+		std::size_t capacity; //< number of chunk pointers allocated.
+		Chunk** chunks;
+	};
+
+	static std::uint64_t newOwner() {
+		static std::atomic<std::uint64_t> next(1);
+		return next.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Directory* newDirectory(std::size_t capacity) {
+		assert(_arena != nullptr);
+		Directory* dir = _arena->create<Directory>();
+		dir->owner = _owner;
+		dir->count = 0;
+		dir->capacity = capacity;
+		dir->chunks = static_cast<Chunk**>(_arena->allocate(capacity * sizeof(Chunk*), alignof(Chunk*)));
+		return dir;
+	}
+
+	/// A directory this vector may write, with room for at least capacity chunks.
+	Directory* writableDirectory(std::size_t capacity) {
+		if (_dir != nullptr && _dir->owner == _owner && capacity <= _dir->capacity) {
+			return _dir;
+		}
+
+		std::size_t count = _dir != nullptr ? _dir->count : 0;
+		std::size_t oldCapacity = _dir != nullptr ? _dir->capacity : 0;
+		std::size_t newCapacity = oldCapacity < capacity ? (capacity > 2 * oldCapacity ? capacity : 2 * oldCapacity) : oldCapacity;
+
+		Directory* dir = newDirectory(newCapacity);
+		for (std::size_t i = 0; i < count; ++i) {
+			dir->chunks[i] = _dir->chunks[i];
+		}
+		dir->count = count;
+		_dir = dir;
+		return _dir;
+	}
+
+	/// Make room for n chunks. New chunks are allocated on first write.
+	void reserveChunks(std::size_t n) {
+		if (_dir != nullptr && n <= _dir->count) {
+			return;
+		}
+		Directory* dir = writableDirectory(n);
+		for (std::size_t i = dir->count; i < n; ++i) {
+			dir->chunks[i] = nullptr;
+		}
+		dir->count = n;
+	}
+
+	Chunk* writableChunk(std::size_t c) {
+		Chunk* chunk = _dir->chunks[c];
+		if (chunk != nullptr && chunk->owner == _owner) {
+			return chunk;
+		}
+
+		Chunk* copy = _arena->create<Chunk>();
+		copy->owner = _owner;
+		if (chunk != nullptr) {
+			for (std::size_t i = 0; i < CHUNK; ++i) {
+				copy->items[i] = chunk->items[i];
+			}
+		}
+
+		writableDirectory(_dir->count)->chunks[c] = copy;
+		return copy;
+	}
+
+	Arena* _arena;
+	Directory* _dir;
+	std::size_t _size;
+	mutable std::uint64_t _owner; //< ownership token. Changes whenever this vector is copied.
+};
+
+}  // namespace OMR
+
+#endif // OMR_PERSISTENTVECTOR_HPP_
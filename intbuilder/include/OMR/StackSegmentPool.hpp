@@ -0,0 +1,81 @@
+#if !defined(OMR_STACKSEGMENTPOOL_HPP_)
+#define OMR_STACKSEGMENTPOOL_HPP_
+
+#include <OMR/GuardedStack.hpp>
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace OMR {
+
+/// A thread safe pool of guarded stack segments, all of one size.
+///
+/// Released segments are kept for reuse, up to a limit, so growing and shrinking a
+/// segmented stack does not map and unmap memory every time. Segments larger than
+/// the pool's size are never pooled: they are unmapped when released.
+class StackSegmentPool {
+public:
+	static constexpr std::size_t DEFAULT_SEGMENT_SIZE = 16 * 1024; //< in bytes.
+	static constexpr std::size_t DEFAULT_MAX_POOLED   = 1024;      //< in segments.
+
+	struct Stats {
+		std::size_t mapped = 0;   //< segments created.
+		std::size_t reused = 0;   //< acquisitions satisfied from the pool.
+		std::size_t pooled = 0;   //< segments waiting for reuse.
+	};
+
+	explicit StackSegmentPool(std::size_t segmentSize = DEFAULT_SEGMENT_SIZE, std::size_t maxPooled = DEFAULT_MAX_POOLED)
+		: _segmentSize(GuardedStack::roundToPages(segmentSize)), _maxPooled(maxPooled), _mutex(), _free(), _stats() {}
+
+	StackSegmentPool(const StackSegmentPool&) = delete;
+
+	StackSegmentPool& operator=(const StackSegmentPool&) = delete;
+
+	std::size_t segmentSize() const { return _segmentSize; }
+
+	/// A segment of at least size bytes. Pooled segments are not cleared.
+	GuardedStack acquire(std::size_t size = 0) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (size <= _segmentSize && !_free.empty()) {
+				GuardedStack segment = std::move(_free.back());
+				_free.pop_back();
+				_stats.reused += 1;
+				_stats.pooled = _free.size();
+				return segment;
+			}
+			_stats.mapped += 1;
+		}
+		return GuardedStack(size > _segmentSize ? size : _segmentSize);
+	}
+
+	/// Return a segment to the pool, or unmap it.
+	void release(GuardedStack segment) {
+		if (segment.size() != _segmentSize) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_free.size() < _maxPooled) {
+			_free.push_back(std::move(segment));
+			_stats.pooled = _free.size();
+		}
+	}
+
+	Stats stats() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _stats;
+	}
+
+private:
+	std::size_t _segmentSize;
+	std::size_t _maxPooled;
+	mutable std::mutex _mutex;
+	std::vector<GuardedStack> _free;
+	Stats _stats;
+};
+
+}  // namespace OMR
+
+#endif // OMR_STACKSEGMENTPOOL_HPP_